@@ -0,0 +1,94 @@
+#include "ui.h"
+
+// Backend without a window, for benchmarks, replays and batch rendering.
+// Text is measured as a monospaced font so layouts are deterministic, drawing only counts the calls.
+
+int HEADLESS_CHAR_WIDTH = 10;
+int HEADLESS_LINE_HEIGHT = 20;
+int HEADLESS_IMAGE_SIZE = 64;
+
+struct Headless_State {
+    size_t drawCalls = 0;
+};
+
+Headless_State headlessState;
+
+// state of the current context if it was set up with UI_Headless_InitContext
+Headless_State &Headless_CurrentState() {
+    void *data = UI::UI_CurrentContext().backendData.get();
+    return data != nullptr ? *static_cast<Headless_State *>(data) : headlessState;
+}
+
+size_t Headless_DrawCalls(UI::UI_Context &context) {
+    void *data = context.backendData.get();
+    return data != nullptr ? static_cast<Headless_State *>(data)->drawCalls : headlessState.drawCalls;
+}
+
+void Headless_DrawText(const char *str, const int x, const int y, const float scale) {
+    Headless_CurrentState().drawCalls++;
+}
+
+float Headless_MeasureText(const char *str, const float scale) {
+    // width of the longest line
+    int longest = 0;
+    int current = 0;
+    for (const char *c = str; *c != '\0'; c++) {
+        current = *c == '\n' ? 0 : current + 1;
+        longest = std::max(longest, current);
+    }
+    return longest * HEADLESS_CHAR_WIDTH * scale;
+}
+
+float Headless_MeasureTextHeight(const char *str, const float scale) {
+    int lines = 1;
+    for (const char *c = str; *c != '\0'; c++) {
+        if (*c == '\n')
+            lines++;
+    }
+    return lines * HEADLESS_LINE_HEIGHT * scale;
+}
+
+void Headless_DrawRectangle(const int x, const int y, const int w, const int h, const std::array<int, 4> color) {
+    Headless_CurrentState().drawCalls++;
+}
+
+void Headless_DrawImage(const std::string &path, const int x, const int y, const int w, const int h) {
+    Headless_CurrentState().drawCalls++;
+}
+
+std::array<int, 2> Headless_MeasureImage(const std::string &path) {
+    return {HEADLESS_IMAGE_SIZE, HEADLESS_IMAGE_SIZE};
+}
+
+// input is expected to come from UI::inputSnapshot (e.g. a replay), without one the mouse is parked off screen
+std::array<float, 2> Headless_GetMousePos() {
+    return {-1, -1};
+}
+
+bool Headless_IsMousePressed() {
+    return false;
+}
+
+void UI_Headless_Init() {
+    UI::getMousePosFn = &Headless_GetMousePos;
+    UI::isMousePressedFn = &Headless_IsMousePressed;
+    UI::drawTextFn = &Headless_DrawText;
+    UI::drawRectFn = &Headless_DrawRectangle;
+    UI::drawImageFn = &Headless_DrawImage;
+    UI::measureImageFn = &Headless_MeasureImage;
+    UI::measureTextFn = &Headless_MeasureText;
+    UI::measureTextHeightFn = &Headless_MeasureTextHeight;
+}
+
+// sets up a context of its own, e.g. one per thread
+void UI_Headless_InitContext(UI::UI_Context &context) {
+    context.getMousePosFn = &Headless_GetMousePos;
+    context.isMousePressedFn = &Headless_IsMousePressed;
+    context.drawTextFn = &Headless_DrawText;
+    context.drawRectFn = &Headless_DrawRectangle;
+    context.drawImageFn = &Headless_DrawImage;
+    context.measureImageFn = &Headless_MeasureImage;
+    context.measureTextFn = &Headless_MeasureText;
+    context.measureTextHeightFn = &Headless_MeasureTextHeight;
+    context.backendData = std::make_shared<Headless_State>();
+}
@@ -2,8 +2,10 @@
 // Created by Qiaozhi Lei on 4/29/25.
 //
 
+#include <cmath>
 #include <iostream>
 #include <map>
+#include <mutex>
 
 #include "ui.h"
 #include <raylib.h>
@@ -39,33 +41,151 @@ void Raylib_DrawRectangle(const int x, const int y, const int w, const int h, co
     DrawRectangle(x, y, w, h, c);
 }
 
-std::map<std::string, Texture2D> textures = {};
+bool RAYLIB_IMAGE_MIPMAPS = true;
+// when an image is drawn larger than its texture, the texture is regenerated this much larger than needed
+float RAYLIB_IMAGE_HEADROOM = 1.25f;
 
-void Raylib_DrawImage(const std::string &path, const int x, const int y, const int w, const int h) {
-    if (textures.find(path) == textures.end()) {
-        std::cout << "Loading texture " << path << std::endl;
-        if (!FileExists(path.c_str())) {
-            std::cerr << "Texture file not found: " << path << std::endl;
-            return;
+// Image sizes are cached apart from the textures and behind a lock, since layout may measure images off the render
+// thread (e.g. on the FramePipeline worker) while the render thread draws them
+std::mutex imageSizesMutex;
+std::map<std::string, std::array<int, 2> > imageSizes = {};
+// images decoded to read their size, kept until their first texture is built so the file is decoded only once
+// (an image that is measured but never drawn keeps its pixels here, see Raylib_CacheBytes)
+std::map<std::string, Image> decodedImages = {};
+
+// returns {0, 0} if the file does not exist
+std::array<int, 2> Raylib_ImageSize(const std::string &path) {
+    {
+        std::lock_guard lock(imageSizesMutex);
+        const auto it = imageSizes.find(path);
+        if (it != imageSizes.end())
+            return it->second;
+    }
+
+    std::cout << "Loading image " << path << std::endl;
+    if (!FileExists(path.c_str())) {
+        std::cerr << "Texture file not found: " << path << std::endl;
+        std::lock_guard lock(imageSizesMutex);
+        return imageSizes.emplace(path, std::array<int, 2>{0, 0}).first->second;
+    }
+    const Image image = LoadImage(path.c_str());
+
+    std::lock_guard lock(imageSizesMutex);
+    const auto [it, inserted] = imageSizes.emplace(path, std::array<int, 2>{image.width, image.height});
+    if (inserted)
+        decodedImages.emplace(path, image);
+    else
+        UnloadImage(image); // another thread decoded it first
+    return it->second;
+}
+
+// the image decoded by Raylib_ImageSize if its texture was not built yet, otherwise decodes the file again
+Image Raylib_TakeImage(const std::string &path) {
+    {
+        std::lock_guard lock(imageSizesMutex);
+        const auto it = decodedImages.find(path);
+        if (it != decodedImages.end()) {
+            const Image image = it->second;
+            decodedImages.erase(it);
+            return image;
         }
-        textures[path] = LoadTexture(path.c_str());
     }
-    Texture2D texture = textures[path];
+    return LoadImage(path.c_str());
+}
+
+// Textures are kept at the largest size the image was drawn at (in pixels, including DPI scaling), not the size of
+// the file, and only regenerated when the image is drawn larger. Only used on the render thread.
+struct Raylib_CachedImage {
+    Texture2D texture = {};
+    int sourceWidth = 0;
+    int sourceHeight = 0;
+    int drawnWidth = 0;
+    int drawnHeight = 0;
+};
+
+std::map<std::string, Raylib_CachedImage> textures = {};
+
+Raylib_CachedImage *Raylib_FindImage(const std::string &path) {
+    const auto it = textures.find(path);
+    if (it != textures.end())
+        return &it->second;
+
+    const std::array<int, 2> size = Raylib_ImageSize(path);
+    if (size[0] == 0 || size[1] == 0)
+        return nullptr;
+    Raylib_CachedImage &cached = textures[path];
+    cached.sourceWidth = size[0];
+    cached.sourceHeight = size[1];
+    return &cached;
+}
+
+void Raylib_ResizeTexture(const std::string &path, Raylib_CachedImage &cached) {
+    const float scale = std::min(1.0f, RAYLIB_IMAGE_HEADROOM * std::max(
+                                           static_cast<float>(cached.drawnWidth) / cached.sourceWidth,
+                                           static_cast<float>(cached.drawnHeight) / cached.sourceHeight));
+    Image image = Raylib_TakeImage(path);
+    if (scale < 1.0f) {
+        ImageResize(&image, std::max(1, static_cast<int>(std::ceil(cached.sourceWidth * scale))),
+                    std::max(1, static_cast<int>(std::ceil(cached.sourceHeight * scale))));
+    }
+    if (RAYLIB_IMAGE_MIPMAPS)
+        ImageMipmaps(&image);
+
+    if (cached.texture.id != 0)
+        UnloadTexture(cached.texture);
+    cached.texture = LoadTextureFromImage(image);
+    SetTextureFilter(cached.texture, RAYLIB_IMAGE_MIPMAPS ? TEXTURE_FILTER_TRILINEAR : TEXTURE_FILTER_BILINEAR);
+    UnloadImage(image);
+}
+
+void Raylib_DrawImage(const std::string &path, const int x, const int y, const int w, const int h) {
+    Raylib_CachedImage *cached = Raylib_FindImage(path);
+    if (cached == nullptr)
+        return;
+
+    const Vector2 dpi = GetWindowScaleDPI();
+    const int pixelWidth = static_cast<int>(std::ceil(w * dpi.x));
+    const int pixelHeight = static_cast<int>(std::ceil(h * dpi.y));
+    cached->drawnWidth = std::max(cached->drawnWidth, pixelWidth);
+    cached->drawnHeight = std::max(cached->drawnHeight, pixelHeight);
+    const bool atSourceSize = cached->texture.width >= cached->sourceWidth;
+    if (cached->texture.id == 0 ||
+        (!atSourceSize && (pixelWidth > cached->texture.width || pixelHeight > cached->texture.height))) {
+        Raylib_ResizeTexture(path, *cached);
+    }
+
+    const Texture2D &texture = cached->texture;
     DrawTexturePro(texture, {0, 0, static_cast<float>(texture.width), static_cast<float>(texture.height)},
                    {static_cast<float>(x), static_cast<float>(y), static_cast<float>(w), static_cast<float>(h)},
                    {0, 0}, 0.0f, WHITE);
 }
 
 std::array<int, 2> Raylib_MeasureImage(const std::string &path) {
-    if (textures.find(path) == textures.end()) {
-        if (!FileExists(path.c_str())) {
-            std::cerr << "Texture file not found: " << path << std::endl;
-            return {0, 0};
+    return Raylib_ImageSize(path);
+}
+
+// call on the render thread
+size_t Raylib_CacheBytes() {
+    size_t bytes = 0;
+    {
+        std::lock_guard lock(imageSizesMutex);
+        for (const auto &[path, size]: imageSizes)
+            bytes += sizeof(size) + path.capacity();
+        for (const auto &[path, image]: decodedImages)
+            bytes += sizeof(image) + path.capacity() + GetPixelDataSize(image.width, image.height, image.format);
+    }
+    for (const auto &[path, cached]: textures) {
+        const Texture2D &texture = cached.texture;
+        bytes += sizeof(cached) + path.capacity();
+        int width = texture.width;
+        int height = texture.height;
+        for (int level = 0; level < texture.mipmaps; level++) {
+            bytes += GetPixelDataSize(width, height, texture.format);
+            width = std::max(1, width / 2);
+            height = std::max(1, height / 2);
         }
-        textures[path] = LoadTexture(path.c_str());
     }
-    Texture2D texture = textures[path];
-    return {texture.width, texture.height};
+    return bytes;
 }
 
 std::array<float, 2> Raylib_GetMousePos() {
@@ -82,4 +202,5 @@ void UI_Raylib_Init() {
     UI::measureImageFn = &Raylib_MeasureImage;
     UI::measureTextFn = &Raylib_MeasureText;
     UI::measureTextHeightFn = &Raylib_MeasureTextHeight;
+    UI::cacheBytesFn = &Raylib_CacheBytes;
 }
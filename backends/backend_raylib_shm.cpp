@@ -0,0 +1,68 @@
+#include <deque>
+#include <iostream>
+
+#include "shm_ring.h"
+#include <raylib.h>
+
+// defined in backend_raylib.cpp
+std::array<float, 2> Raylib_GetMousePos();
+
+bool Raylib_IsMousePressed();
+
+// One UI process feeding the renderer
+struct Raylib_ShmProducer {
+    UI::SharedMemory drawMemory;
+    UI::SharedMemory inputMemory;
+    UI::SpscRing drawRing;
+    UI::SpscRing inputRing;
+    // last complete frame, redrawn until a newer one arrives
+    UI::DrawList frame;
+};
+
+// Renderer process side of backend_shm: draws the latest frame of each UI process and sends input back.
+// Several tool processes can share one window, their frames are drawn in the order of names (later ones on top) and
+// every process receives the same input. Call after InitWindow and UI_Raylib_Init, returns when the window is closed.
+bool Raylib_ServeShm(const std::vector<std::string> &names) {
+    // deque, since the shared memory mappings cannot move
+    std::deque<Raylib_ShmProducer> producers;
+    for (const auto &name: names) {
+        Raylib_ShmProducer &producer = producers.emplace_back();
+        if (!producer.drawMemory.Open(UI::ShmDrawRingName(name), UI::SpscRing::BytesFor(UI::SHM_DRAW_RING_SIZE)) ||
+            !producer.inputMemory.Open(UI::ShmInputRingName(name),
+                                       UI::SpscRing::BytesFor(UI::SHM_INPUT_RING_SIZE))) {
+            std::cerr << "Failed to open shared memory: " << name << std::endl;
+            return false;
+        }
+        producer.drawRing = UI::SpscRing(producer.drawMemory.Data(), UI::SHM_DRAW_RING_SIZE, false);
+        producer.inputRing = UI::SpscRing(producer.inputMemory.Data(), UI::SHM_INPUT_RING_SIZE, false);
+    }
+
+    std::vector<uint8_t> scratch;
+    int64_t timestamp = 0;
+    while (!WindowShouldClose()) {
+        // skip to the newest frame of each producer
+        for (auto &producer: producers) {
+            while (UI::ReadFrame(producer.drawRing, producer.frame, scratch, timestamp)) {
+            }
+        }
+
+        BeginDrawing();
+        ClearBackground(BLACK);
+        for (const auto &producer: producers)
+            UI::UI_SubmitDrawList(producer.frame);
+        EndDrawing();
+
+        UI::InputState input;
+        input.mousePos = Raylib_GetMousePos();
+        input.mousePressed = Raylib_IsMousePressed();
+        for (auto &producer: producers) {
+            if (producer.inputRing.Write(&input, sizeof(input)))
+                producer.inputRing.Commit();
+        }
+    }
+    return true;
+}
+
+bool Raylib_ServeShm(const std::string &name) {
+    return Raylib_ServeShm(std::vector<std::string>{name});
+}
@@ -0,0 +1,100 @@
+#include <iostream>
+
+#include "shm_ring.h"
+
+// Producer side of the out-of-process renderer: draw calls are serialised into a shared-memory ring that a renderer
+// process (e.g. Raylib_ServeShm in backend_raylib_shm.cpp) consumes, input comes back through a second ring.
+// Text and image measurement still runs in this process, set measureTextFn etc. as usual.
+
+UI::SharedMemory shmDrawMemory;
+UI::SharedMemory shmInputMemory;
+UI::SpscRing shmDrawRing;
+UI::SpscRing shmInputRing;
+UI::InputState shmInput;
+bool shmFrameFits = true;
+size_t shmDroppedFrames = 0;
+
+std::vector<uint8_t> shmInputScratch;
+UI::DrawCommand shmCommand;
+
+void Shm_Write(const UI::DrawCommand &command) {
+    if (shmFrameFits)
+        shmFrameFits = UI::WriteDrawCommand(shmDrawRing, command);
+}
+
+void Shm_DrawRectangle(const int x, const int y, const int w, const int h, const std::array<int, 4> color) {
+    shmCommand.type = UI::DrawCommand::RECTANGLE;
+    shmCommand.x = x;
+    shmCommand.y = y;
+    shmCommand.w = w;
+    shmCommand.h = h;
+    shmCommand.color = color;
+    shmCommand.str.clear();
+    Shm_Write(shmCommand);
+}
+
+void Shm_DrawText(const char *str, const int x, const int y, const float scale) {
+    shmCommand.type = UI::DrawCommand::TEXT;
+    shmCommand.x = x;
+    shmCommand.y = y;
+    shmCommand.scale = scale;
+    shmCommand.str.assign(str);
+    Shm_Write(shmCommand);
+}
+
+void Shm_DrawImage(const std::string &path, const int x, const int y, const int w, const int h) {
+    shmCommand.type = UI::DrawCommand::IMAGE;
+    shmCommand.x = x;
+    shmCommand.y = y;
+    shmCommand.w = w;
+    shmCommand.h = h;
+    shmCommand.str.assign(path);
+    Shm_Write(shmCommand);
+}
+
+// keeps the latest mouse position, a press stays set until the end of the frame
+void Shm_PollInput() {
+    while (shmInputRing.Read(shmInputScratch)) {
+        UI::InputState input;
+        std::memcpy(&input, shmInputScratch.data(), sizeof(input));
+        shmInput.mousePos = input.mousePos;
+        shmInput.mousePressed |= input.mousePressed;
+    }
+}
+
+std::array<float, 2> Shm_GetMousePos() {
+    Shm_PollInput();
+    return shmInput.mousePos;
+}
+
+bool Shm_IsMousePressed() {
+    Shm_PollInput();
+    return shmInput.mousePressed;
+}
+
+// call after DrawUI, publishes the frame or drops it whole if the renderer has fallen behind
+void UI_Shm_EndFrame() {
+    if (!shmFrameFits || !UI::WriteFrameEnd(shmDrawRing)) {
+        shmDrawRing.Rollback();
+        shmDroppedFrames++;
+    }
+    shmFrameFits = true;
+    shmInput.mousePressed = false;
+}
+
+bool UI_Shm_Init(const std::string &name) {
+    if (!shmDrawMemory.Create(UI::ShmDrawRingName(name), UI::SpscRing::BytesFor(UI::SHM_DRAW_RING_SIZE)) ||
+        !shmInputMemory.Create(UI::ShmInputRingName(name), UI::SpscRing::BytesFor(UI::SHM_INPUT_RING_SIZE))) {
+        std::cerr << "Failed to create shared memory: " << name << std::endl;
+        return false;
+    }
+    shmDrawRing = UI::SpscRing(shmDrawMemory.Data(), UI::SHM_DRAW_RING_SIZE, true);
+    shmInputRing = UI::SpscRing(shmInputMemory.Data(), UI::SHM_INPUT_RING_SIZE, true);
+
+    UI::getMousePosFn = &Shm_GetMousePos;
+    UI::isMousePressedFn = &Shm_IsMousePressed;
+    UI::drawTextFn = &Shm_DrawText;
+    UI::drawRectFn = &Shm_DrawRectangle;
+    UI::drawImageFn = &Shm_DrawImage;
+    return true;
+}
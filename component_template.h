@@ -0,0 +1,178 @@
+#ifndef COMPONENT_TEMPLATE_H
+#define COMPONENT_TEMPLATE_H
+
+#include "ui.h"
+#include <cassert>
+
+namespace UI {
+    // Flyweight list of identical components.
+    // The prototype subtree (structure, sizing and handlers) exists once and is laid out once per frame,
+    // each instance only stores its own data. Instances are stacked along the main axis of the linked element,
+    // and drawing/input move the prototype to each instance in turn, with Current() returning that instance's data:
+    //
+    //     UI_Template<Row> rows;
+    //     rows.prototype = LayoutBuilder{}.size(GROW, 30).children(
+    //         LayoutBuilder{}.drawFn([&](LayoutElement *l) { UI_DrawText(rows.Current().text.c_str(), l->x, l->y, 1); })
+    //     );
+    //
+    // The prototype must not depend on instance data for its size. Its updateFn and mouse events only run for the
+    // instance under the mouse, per-instance state (e.g. hover) belongs in Instance.
+    template<typename Instance>
+    struct UI_Template {
+        Layout::LayoutElement *layout;
+        Layout::LayoutElement prototype;
+        std::vector<Instance> instances;
+        int current = -1;
+        int hovered = -1;
+        std::vector<Layout::LayoutElement *> toExplore;
+
+        // only valid inside the prototype's handlers, while drawing or detecting input for an instance
+        Instance &Current() {
+            assert(current >= 0 && current < static_cast<int>(instances.size()));
+            return instances[current];
+        }
+
+        // distance between instances, 0 or less when they take no space (e.g. an empty FIT prototype with no gap)
+        int Stride() const {
+            return prototype.GetDimension(layout->mainAxis) + layout->gap;
+        }
+
+        void SizeFn(Layout::LayoutElement *layout) {
+            // fill the cross axis of the list if the prototype grows along it
+            const Layout::AxisDirection crossAxis = layout->GetCrossAxis();
+            const Layout::Sizing crossSizing = prototype.GetSizing(crossAxis);
+            if (crossSizing == Layout::GROW) {
+                const int available = layout->GetDimension(crossAxis) - layout->padding * 2;
+                if (crossAxis == Layout::HORIZONTAL) {
+                    prototype.width = std::min(available, prototype.maxWidth);
+                    prototype.widthSizing = Layout::FIXED;
+                } else {
+                    prototype.height = std::min(available, prototype.maxHeight);
+                    prototype.heightSizing = Layout::FIXED;
+                }
+            }
+            Layout::CalculateLayout(prototype, UI_CurrentContext().layout);
+            if (crossAxis == Layout::HORIZONTAL)
+                prototype.widthSizing = crossSizing;
+            else
+                prototype.heightSizing = crossSizing;
+
+            const int count = static_cast<int>(instances.size());
+            if (layout->GetMainSizing() != Layout::FIXED) {
+                int main = count * std::max(0, prototype.GetDimension(layout->mainAxis)) + layout->padding * 2;
+                if (count > 0)
+                    main += std::max(0, layout->gap) * (count - 1);
+                layout->AddDimension(layout->mainAxis, main - layout->GetDimension(layout->mainAxis));
+            }
+            if (layout->GetCrossSizing() == Layout::FIT) {
+                const int cross = std::max(0, prototype.GetDimension(crossAxis)) + layout->padding * 2;
+                layout->AddDimension(crossAxis, cross - layout->GetDimension(crossAxis));
+            }
+        }
+
+        void DrawFn(Layout::LayoutElement *layout) {
+            if (Stride() <= 0)
+                return;
+            for (int i = 0; i < static_cast<int>(instances.size()); i++) {
+                MoveTo(i);
+                current = i;
+                Layout::DrawUI(prototype, UI_CurrentContext().layout);
+            }
+            current = -1;
+        }
+
+        void UpdateFn(Layout::LayoutElement *layout) {
+            const int index = InstanceUnderMouse();
+            if (hovered != index && hovered != -1) {
+                // the mouse left the previous instance, end the hover state of its nodes
+                if (hovered < static_cast<int>(instances.size())) {
+                    MoveTo(hovered);
+                    current = hovered;
+                }
+                LeavePrototype();
+            }
+            hovered = index;
+            if (index != -1) {
+                MoveTo(index);
+                current = index;
+                DetectInputEvents(prototype, UI_CurrentContext().layout);
+            }
+            current = -1;
+        }
+
+        void Link() {
+            if (layout == nullptr) return;
+            layout->sizeFn = [&](Layout::LayoutElement *layout) {
+                SizeFn(layout);
+            };
+            layout->drawFn = [&](Layout::LayoutElement *layout) {
+                DrawFn(layout);
+            };
+            layout->updateFn = [&](Layout::LayoutElement *layout) {
+                UpdateFn(layout);
+            };
+        }
+
+    private:
+        void MoveTo(const int index) {
+            int main = layout->GetMainCoord() + layout->padding + index * std::max(0, Stride());
+            int cross = layout->GetCrossCoord() + layout->padding;
+            if (layout->mainAxis == Layout::VERTICAL)
+                std::swap(main, cross);
+            const int dx = main - prototype.x;
+            const int dy = cross - prototype.y;
+            if (dx == 0 && dy == 0)
+                return;
+
+            toExplore.emplace_back(&prototype);
+            while (!toExplore.empty()) {
+                Layout::LayoutElement *current = toExplore.back();
+                toExplore.pop_back();
+
+                current->x += dx;
+                current->y += dy;
+
+                for (auto &child: current->children) {
+                    toExplore.emplace_back(&child);
+                }
+            }
+        }
+
+        int InstanceUnderMouse() const {
+            if (instances.empty() || Stride() <= 0 || !CollisionMouseLayout(*layout))
+                return -1;
+            const std::array<float, 2> mouse = UI_GetMousePos();
+            const bool horizontal = layout->mainAxis == Layout::HORIZONTAL;
+            const float main = (horizontal ? mouse[0] : mouse[1]) - layout->GetMainCoord() - layout->padding;
+            const float cross = (horizontal ? mouse[1] : mouse[0]) - layout->GetCrossCoord() - layout->padding;
+            if (main < 0 || cross < 0 || cross > prototype.GetDimension(layout->GetCrossAxis()))
+                return -1;
+            const int index = static_cast<int>(main) / Stride();
+            // the gap between instances belongs to no instance
+            if (index >= static_cast<int>(instances.size()) ||
+                main - index * Stride() > prototype.GetDimension(layout->mainAxis))
+                return -1;
+            return index;
+        }
+
+        void LeavePrototype() {
+            toExplore.emplace_back(&prototype);
+            while (!toExplore.empty()) {
+                Layout::LayoutElement *current = toExplore.back();
+                toExplore.pop_back();
+
+                if (current->hovering) {
+                    if (current->onMouseLeaveFn != nullptr && this->current != -1)
+                        current->onMouseLeaveFn(current);
+                    current->hovering = false;
+                }
+
+                for (auto &child: current->children) {
+                    toExplore.emplace_back(&child);
+                }
+            }
+        }
+    };
+}
+
+#endif //COMPONENT_TEMPLATE_H
@@ -13,23 +13,23 @@ using namespace Layout;
 struct InputHint {
     LayoutElement root;
     UI_Text label = {
-        .wrap = WRAP_NONE,
-        .scale = 1.0
+        .scale = 1.0,
+        .wrap = WRAP_NONE
     };
     std::string iconPath;
 
     InputHint(const std::string &text, const std::string &iconPath) : iconPath(std::move(iconPath)) {
         label.text = std::move(text);
         root = LayoutBuilder{}.name("Input Hint").size(FIT, FIT)
-                .children({
+                .children(
                     LayoutBuilder{}.name("Input").size(0, GROW)
                     .sizeFn([](LayoutElement *layout) { layout->width = layout->height; })
                     .drawFn([&](LayoutElement *layout) {
                         // UI_DrawRectangle(layout->x, layout->y, layout->width, layout->height, UI_GRAY);
                         UI_DrawImage(this->iconPath, layout->x, layout->y, layout->width, layout->height);
                     }),
-                    LayoutBuilder{}.name("Label").pointer(&label.layout),
-                });
+                    LayoutBuilder{}.name("Label").pointer(&label.layout)
+                );
 
         InitReferencePointers(root);
         label.Link();
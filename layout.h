@@ -4,9 +4,22 @@
 
 #ifndef LAYOUT_H
 #define LAYOUT_H
+#include <array>
+#include <cassert>
+#include <climits>
+#include <cstdint>
+#include <functional>
 #include <string>
+#include <string_view>
+#include <type_traits>
+#include <unordered_map>
 #include <vector>
 
+// LAYOUT_STRIP_DEBUG compiles out the debug data of elements (debug names, capture accounting) for release builds
+#if defined(LAYOUT_STRIP_DEBUG) && defined(LAYOUT_VERBOSE)
+#error "LAYOUT_VERBOSE needs the debug data removed by LAYOUT_STRIP_DEBUG"
+#endif
+
 namespace Layout {
     enum AxisDirection {
         HORIZONTAL,
@@ -25,13 +38,31 @@ namespace Layout {
         GROW
     };
 
+    // Stable element id, the hash of a name given through LayoutBuilder::id, 0 means no id
+    using ElementId = uint64_t;
+
+    constexpr ElementId HashId(const std::string_view name) {
+        // FNV-1a
+        ElementId hash = 14695981039346656037ull;
+        for (const char c: name) {
+            hash ^= static_cast<unsigned char>(c);
+            hash *= 1099511628211ull;
+        }
+        return hash == 0 ? 1 : hash;
+    }
+
     struct LayoutElement;
     using DrawFn = std::function<void(LayoutElement *)>;
     using SizeFn = std::function<void(LayoutElement *)>;
     using EventFn = std::function<void(LayoutElement *)>;
 
     struct LayoutElement {
+#ifndef LAYOUT_STRIP_DEBUG
         std::string debugName = "Element";
+        // estimated heap bytes of the handlers' functors, see LayoutBuilder::CaptureHeapBytes
+        uint32_t captureBytes = 0;
+#endif
+        ElementId id = 0;
         int width = 0;
         int height = 0;
         int x = 0;
@@ -58,7 +89,7 @@ namespace Layout {
         EventFn onMouseEnterFn = nullptr;
         EventFn onMouseLeaveFn = nullptr;
         EventFn onMouseClickFn = nullptr;
-        bool hovering;
+        bool hovering = false;
 
         LayoutElement **referencePointer = nullptr;
 
@@ -98,6 +129,8 @@ namespace Layout {
                     return "F";
                 case GROW:
                     return "G";
+                case FIXED:
+                    break;
             }
             return "";
         }
@@ -131,8 +164,15 @@ namespace Layout {
     struct LayoutBuilder {
         LayoutElement current;
 
-        LayoutBuilder &name(const std::string &name) {
-            current.debugName = name;
+        LayoutBuilder &name(std::string name) {
+#ifndef LAYOUT_STRIP_DEBUG
+            current.debugName = std::move(name);
+#endif
+            return *this;
+        }
+
+        LayoutBuilder &id(const std::string_view name) {
+            current.id = HashId(name);
             return *this;
         }
 
@@ -227,38 +267,60 @@ namespace Layout {
             return *this;
         }
 
+        // Elements of a braced list are const and get copied, with their whole subtree, at every nesting level.
+        // Prefer the variadic overload for deep trees.
         LayoutBuilder &children(std::vector<LayoutElement> children) {
             current.children = std::move(children);
             return *this;
         }
 
-        LayoutBuilder &drawFn(const DrawFn &drawFn) {
-            current.drawFn = drawFn;
+        // moves each child (builder or element) into place exactly once: .children(LayoutBuilder{}..., LayoutBuilder{}...)
+        template<typename... Children>
+        LayoutBuilder &children(Children &&... children) {
+            current.children.reserve(current.children.size() + sizeof...(children));
+            (current.children.emplace_back(std::forward<Children>(children)), ...);
             return *this;
         }
 
-        LayoutBuilder &sizeFn(const SizeFn &sizeFn) {
-            current.sizeFn = sizeFn;
+        template<typename F>
+        LayoutBuilder &drawFn(F &&drawFn) {
+            current.drawFn = std::forward<F>(drawFn);
+            TrackCapture<F>();
             return *this;
         }
 
-        LayoutBuilder &updateFn(const EventFn &updateFn) {
-            current.updateFn = updateFn;
+        template<typename F>
+        LayoutBuilder &sizeFn(F &&sizeFn) {
+            current.sizeFn = std::forward<F>(sizeFn);
+            TrackCapture<F>();
             return *this;
         }
 
-        LayoutBuilder &onMouseEnterFn(const EventFn &onHoverFn) {
-            current.onMouseEnterFn = onHoverFn;
+        template<typename F>
+        LayoutBuilder &updateFn(F &&updateFn) {
+            current.updateFn = std::forward<F>(updateFn);
+            TrackCapture<F>();
             return *this;
         }
 
-        LayoutBuilder &onMouseLeaveFn(const EventFn &onMouseLeaveFn) {
-            current.onMouseLeaveFn = onMouseLeaveFn;
+        template<typename F>
+        LayoutBuilder &onMouseEnterFn(F &&onHoverFn) {
+            current.onMouseEnterFn = std::forward<F>(onHoverFn);
+            TrackCapture<F>();
             return *this;
         }
 
-        LayoutBuilder &onMouseClickFn(const EventFn &onMouseClickFn) {
-            current.onMouseClickFn = onMouseClickFn;
+        template<typename F>
+        LayoutBuilder &onMouseLeaveFn(F &&onMouseLeaveFn) {
+            current.onMouseLeaveFn = std::forward<F>(onMouseLeaveFn);
+            TrackCapture<F>();
+            return *this;
+        }
+
+        template<typename F>
+        LayoutBuilder &onMouseClickFn(F &&onMouseClickFn) {
+            current.onMouseClickFn = std::forward<F>(onMouseClickFn);
+            TrackCapture<F>();
             return *this;
         }
 
@@ -271,6 +333,29 @@ namespace Layout {
             return std::move(current);
         }
 
+        // Bytes std::function heap allocates for the functor, following libstdc++ (_Function_base::__stored_locally):
+        // a functor is kept inline only if it is trivially copyable and fits two pointers in size and alignment.
+        // Other standard libraries use other rules, and heap memory owned by the captures is not included,
+        // so this is an estimate of the functor allocation only.
+        template<typename F>
+        static uint32_t CaptureHeapBytes() {
+            using Functor = std::decay_t<F>;
+            if constexpr (std::is_class_v<Functor> && !std::is_same_v<Functor, EventFn>) {
+                constexpr bool storedLocally = std::is_trivially_copyable_v<Functor> &&
+                                               sizeof(Functor) <= 2 * sizeof(void *) &&
+                                               alignof(Functor) <= alignof(void *);
+                return storedLocally ? 0 : sizeof(Functor);
+            }
+            return 0;
+        }
+
+        template<typename F>
+        void TrackCapture() {
+#ifndef LAYOUT_STRIP_DEBUG
+            current.captureBytes += CaptureHeapBytes<F>();
+#endif
+        }
+
         LayoutBuilder copy() const {
             LayoutBuilder builder;
             builder.current = current;
@@ -278,11 +363,165 @@ namespace Layout {
         }
     };
 
-#ifdef LAYOUT_IMPLEMENTATION
+    // O(1) lookup of elements by id.
+    // Children are stored by value, so an element's address changes when its parent's children vector reallocates
+    // or shifts, while deeper descendants stay where they are. Mutating through AddChild/RemoveChild therefore only
+    // has to re-register the siblings of the mutated element, instead of walking the whole tree.
+    // Pointers returned by Find are valid until the next mutation of the tree.
+    // Ids must be unique within the indexed tree, debug builds assert it when elements are added.
+    struct ElementIndex {
+        std::unordered_map<ElementId, LayoutElement *> elements;
+
+        LayoutElement *Find(const ElementId id) const {
+            const auto it = elements.find(id);
+            return it == elements.end() ? nullptr : it->second;
+        }
+
+        LayoutElement *Find(const std::string_view name) const {
+            return Find(HashId(name));
+        }
+
+        // full walk, only needed once for a tree built outside of the index
+        void Build(LayoutElement &root) {
+            elements.clear();
+            AddSubtree(root);
+        }
+
+        // after the root itself was moved, its children did not move
+        void Rebind(LayoutElement &root) {
+            Register(root);
+        }
 
-    void CalculateGrow(LayoutElement &element) {
+        LayoutElement &AddChild(LayoutElement &parent, LayoutElement child) {
+            const bool reallocates = parent.children.size() == parent.children.capacity();
+            parent.children.emplace_back(std::move(child));
+            LayoutElement &added = parent.children.back();
+            if (reallocates)
+                RegisterChildren(parent);
+            AddSubtree(added);
+            return added;
+        }
+
+        void RemoveChild(LayoutElement &parent, const size_t index) {
+            RemoveSubtree(parent.children[index]);
+            parent.children.erase(parent.children.begin() + index);
+            for (size_t i = index; i < parent.children.size(); i++)
+                Register(parent.children[i]);
+        }
+
+    private:
+        void Register(LayoutElement &element) {
+            if (element.id != 0)
+                elements[element.id] = &element;
+            if (element.referencePointer != nullptr)
+                *element.referencePointer = &element;
+        }
+
+        void RegisterChildren(LayoutElement &parent) {
+            for (auto &child: parent.children)
+                Register(child);
+        }
+
+        void AddSubtree(LayoutElement &root) {
+            std::vector<LayoutElement *> toExplore = {&root};
+            while (!toExplore.empty()) {
+                LayoutElement *current = toExplore.back();
+                toExplore.pop_back();
+
+                assert(current->id == 0 || Find(current->id) == nullptr || Find(current->id) == current);
+                Register(*current);
+
+                for (auto &child: current->children) {
+                    toExplore.emplace_back(&child);
+                }
+            }
+        }
+
+        void RemoveSubtree(LayoutElement &root) {
+            std::vector<LayoutElement *> toExplore = {&root};
+            while (!toExplore.empty()) {
+                LayoutElement *current = toExplore.back();
+                toExplore.pop_back();
+
+                // the id may have been registered again by an element added since
+                const auto it = elements.find(current->id);
+                if (it != elements.end() && it->second == current)
+                    elements.erase(it);
+
+                for (auto &child: current->children) {
+                    toExplore.emplace_back(&child);
+                }
+            }
+        }
+    };
+
+    enum FramePhase {
+        PHASE_SIZE,
+        PHASE_GROW,
+        PHASE_CUSTOM_SIZE,
+        PHASE_POSITION,
+        PHASE_DRAW,
+        PHASE_INPUT,
+        PHASE_COUNT
+    };
+
+    // Scratch stacks reused from frame to frame, so that once they have grown to the size of the tree the frame loop
+    // does not allocate. Walks only push and pop above the size they found, so nested walks (e.g. from a sizeFn)
+    // can share the same context.
+    struct LayoutContext {
+        std::vector<LayoutElement *> toExplore;
         std::vector<LayoutElement *> childrenGrowMain;
         std::vector<LayoutElement *> childrenGrowCross;
+        std::vector<LayoutElement *> childrenToGrow;
+
+        // heap allocations per phase, only counted when LAYOUT_COUNT_ALLOCATIONS is defined
+        std::array<size_t, PHASE_COUNT> allocations = {};
+    };
+
+    inline LayoutContext defaultLayoutContext;
+    // context of the calls that don't pass one, UI::ContextScope points it at the layout of its UI_Context
+    inline thread_local LayoutContext *currentLayoutContext = &defaultLayoutContext;
+
+    inline thread_local size_t *allocationCounter = nullptr;
+
+    // Attributes allocations on this thread to a phase of the context until the end of the scope
+    struct AllocationPhase {
+        size_t *previous;
+
+        AllocationPhase(LayoutContext &context, const FramePhase phase) : previous(allocationCounter) {
+            allocationCounter = &context.allocations[phase];
+        }
+
+        ~AllocationPhase() {
+            allocationCounter = previous;
+        }
+    };
+
+    void CalculateGrow(LayoutElement &element, LayoutContext &context = *currentLayoutContext);
+
+    void CalculateSize(LayoutElement &element);
+
+    void DFS_Size(LayoutElement &current);
+
+    void DFS_Grow(LayoutElement &current, LayoutContext &context = *currentLayoutContext);
+
+    void CalculateChildPositions(LayoutElement &element);
+
+    void CustomSizing(LayoutElement &root, LayoutContext &context = *currentLayoutContext);
+
+    void CalculateLayout(LayoutElement &root, LayoutContext &context = *currentLayoutContext);
+
+    void InitReferencePointers(LayoutElement &root, LayoutContext &context = *currentLayoutContext);
+
+    void DrawUI(LayoutElement &root, LayoutContext &context = *currentLayoutContext);
+
+#ifdef LAYOUT_IMPLEMENTATION
+
+    void CalculateGrow(LayoutElement &element, LayoutContext &context) {
+        std::vector<LayoutElement *> &childrenGrowMain = context.childrenGrowMain;
+        std::vector<LayoutElement *> &childrenGrowCross = context.childrenGrowCross;
+        childrenGrowMain.clear();
+        childrenGrowCross.clear();
         int childrenDimensionMain = 0;
         for (auto &child: element.children) {
             if (child.GetSizing(element.mainAxis) == GROW) {
@@ -304,14 +543,15 @@ namespace Layout {
             std::cout << std::endl;
 #endif
 
-            std::vector<LayoutElement *> childrenToGrow;
+            std::vector<LayoutElement *> &childrenToGrow = context.childrenToGrow;
+            childrenToGrow.clear();
             while (mainRemain > 0 && childrenGrowMain.size() > 0) {
                 // find smallest and second smallest
                 int smallest = INT_MAX;
                 int smallestChildIndex = -1;
                 int secondSmallest = INT_MAX;
                 int secondSmallestIndex = -1;
-                for (int i = 0; i < childrenGrowMain.size(); i++) {
+                for (int i = 0; i < static_cast<int>(childrenGrowMain.size()); i++) {
                     auto *child = childrenGrowMain[i];
                     if (child->GetDimension(element.mainAxis) < smallest) {
                         secondSmallest = smallest;
@@ -418,16 +658,54 @@ namespace Layout {
         CalculateSize(current);
     }
 
-    void DFS_Grow(LayoutElement &current) {
-        CalculateGrow(current);
+    void DFS_Grow(LayoutElement &current, LayoutContext &context) {
+        CalculateGrow(current, context);
         for (auto &child: current.children) {
-            DFS_Grow(child);
+            DFS_Grow(child, context);
+        }
+    }
+
+    void CalculateChildPositions(LayoutElement &element) {
+        int childrenMainSum = element.gap * (element.children.size() - 1);
+        for (auto &child: element.children) {
+            childrenMainSum += child.GetDimension(element.mainAxis);
+        }
+        int mainStart = element.GetMainCoord();
+        if (element.mainAlignment == START)
+            mainStart += element.padding;
+        if (element.mainAlignment == CENTER)
+            mainStart += element.GetDimension(element.mainAxis) * 0.5 - childrenMainSum * 0.5;
+        if (element.mainAlignment == END)
+            mainStart += element.GetDimension(element.mainAxis) - childrenMainSum - element.padding;
+
+        // calculate positions of children
+        int mainAxisProcessed = 0;
+        for (auto &child: element.children) {
+            const int main = mainStart + mainAxisProcessed;
+            int cross = element.GetCrossCoord();
+            if (element.crossAlignment == START)
+                cross += element.padding;
+            if (element.crossAlignment == CENTER) {
+                cross += element.GetDimension(element.GetCrossAxis()) * 0.5 - child.GetDimension(
+                    element.GetCrossAxis()) * 0.5;
+            }
+            if (element.crossAlignment == END) {
+                cross += element.GetDimension(element.GetCrossAxis()) - child.GetDimension(
+                    element.GetCrossAxis()) - element.padding;
+            }
+
+            child.SetCoord(main, cross, element.mainAxis);
+
+            mainAxisProcessed += child.GetDimension(element.mainAxis) + element.gap;
         }
     }
 
-    void CustomSizing(LayoutElement &root) {
-        std::vector<LayoutElement *> toExplore = {&root};
-        while (!toExplore.empty()) {
+    void CustomSizing(LayoutElement &root, LayoutContext &context) {
+        AllocationPhase phase(context, PHASE_CUSTOM_SIZE);
+        std::vector<LayoutElement *> &toExplore = context.toExplore;
+        const size_t base = toExplore.size();
+        toExplore.emplace_back(&root);
+        while (toExplore.size() > base) {
             LayoutElement *current = toExplore.back();
             toExplore.pop_back();
 
@@ -440,55 +718,36 @@ namespace Layout {
         }
     }
 
-    void CalculateLayout(LayoutElement &root) {
+    void CalculateLayout(LayoutElement &root, LayoutContext &context) {
         //  Sizes
-        DFS_Size(root);
+        {
+            AllocationPhase phase(context, PHASE_SIZE);
+            DFS_Size(root);
+        }
 
         // Grow
-        DFS_Grow(root);
+        {
+            AllocationPhase phase(context, PHASE_GROW);
+            DFS_Grow(root, context);
+        }
 
-        CustomSizing(root);
+        CustomSizing(root, context);
 
-        DFS_Grow(root);
+        {
+            AllocationPhase phase(context, PHASE_GROW);
+            DFS_Grow(root, context);
+        }
 
         // Positions
-        std::vector<LayoutElement *> toExplore = {&root};
-        while (!toExplore.empty()) {
+        AllocationPhase phase(context, PHASE_POSITION);
+        std::vector<LayoutElement *> &toExplore = context.toExplore;
+        const size_t base = toExplore.size();
+        toExplore.emplace_back(&root);
+        while (toExplore.size() > base) {
             LayoutElement *current = toExplore.back();
             toExplore.pop_back();
 
-            int childrenMainSum = current->gap * (current->children.size() - 1);
-            for (auto &child: current->children) {
-                childrenMainSum += child.GetDimension(current->mainAxis);
-            }
-            int mainStart = current->GetMainCoord();
-            if (current->mainAlignment == START)
-                mainStart += current->padding;
-            if (current->mainAlignment == CENTER)
-                mainStart += current->GetDimension(current->mainAxis) * 0.5 - childrenMainSum * 0.5;
-            if (current->mainAlignment == END)
-                mainStart += current->GetDimension(current->mainAxis) - childrenMainSum - current->padding;
-
-            // calculate positions of children
-            int mainAxisProcessed = 0;
-            for (auto &child: current->children) {
-                const int main = mainStart + mainAxisProcessed;
-                int cross = current->GetCrossCoord();
-                if (current->crossAlignment == START)
-                    cross += current->padding;
-                if (current->crossAlignment == CENTER) {
-                    cross += current->GetDimension(current->GetCrossAxis()) * 0.5 - child.GetDimension(
-                        current->GetCrossAxis()) * 0.5;
-                }
-                if (current->crossAlignment == END) {
-                    cross += current->GetDimension(current->GetCrossAxis()) - child.GetDimension(
-                        current->GetCrossAxis()) - current->padding;
-                }
-
-                child.SetCoord(main, cross, current->mainAxis);
-
-                mainAxisProcessed += child.GetDimension(current->mainAxis) + current->gap;
-            }
+            CalculateChildPositions(*current);
 
             for (auto &child: current->children) {
 #ifdef LAYOUT_VERBOSE
@@ -503,9 +762,11 @@ namespace Layout {
         }
     }
 
-    void InitReferencePointers(LayoutElement &root) {
-        std::vector<LayoutElement *> toExplore = {&root};
-        while (!toExplore.empty()) {
+    void InitReferencePointers(LayoutElement &root, LayoutContext &context) {
+        std::vector<LayoutElement *> &toExplore = context.toExplore;
+        const size_t base = toExplore.size();
+        toExplore.emplace_back(&root);
+        while (toExplore.size() > base) {
             LayoutElement *current = toExplore.back();
             toExplore.pop_back();
 
@@ -518,9 +779,12 @@ namespace Layout {
         }
     }
 
-    void DrawUI(LayoutElement &root) {
-        std::vector<LayoutElement *> toExplore = {&root};
-        while (!toExplore.empty()) {
+    void DrawUI(LayoutElement &root, LayoutContext &context) {
+        AllocationPhase phase(context, PHASE_DRAW);
+        std::vector<LayoutElement *> &toExplore = context.toExplore;
+        const size_t base = toExplore.size();
+        toExplore.emplace_back(&root);
+        while (toExplore.size() > base) {
             LayoutElement *current = toExplore.back();
             toExplore.pop_back();
 
@@ -535,4 +799,62 @@ namespace Layout {
 #endif
 }
 
+#if defined(LAYOUT_IMPLEMENTATION) && defined(LAYOUT_COUNT_ALLOCATIONS)
+#include <cstdlib>
+#include <new>
+
+// once the replaced operators are inlined, GCC pairs the free below with a new it does not know is malloc based
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 11
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+void *operator new(const std::size_t size) {
+    if (Layout::allocationCounter != nullptr)
+        ++*Layout::allocationCounter;
+    if (void *ptr = std::malloc(size == 0 ? 1 : size))
+        return ptr;
+    throw std::bad_alloc();
+}
+
+void *operator new(const std::size_t size, const std::align_val_t alignment) {
+    if (Layout::allocationCounter != nullptr)
+        ++*Layout::allocationCounter;
+    const std::size_t align = static_cast<std::size_t>(alignment);
+    // aligned_alloc wants a multiple of the alignment
+    const std::size_t rounded = ((size == 0 ? 1 : size) + align - 1) / align * align;
+#ifdef _MSC_VER
+    if (void *ptr = _aligned_malloc(rounded, align))
+#else
+    if (void *ptr = std::aligned_alloc(align, rounded))
+#endif
+        return ptr;
+    throw std::bad_alloc();
+}
+
+void operator delete(void *ptr) noexcept {
+    std::free(ptr);
+}
+
+void operator delete(void *ptr, std::size_t) noexcept {
+    std::free(ptr);
+}
+
+void operator delete(void *ptr, std::align_val_t) noexcept {
+#ifdef _MSC_VER
+    _aligned_free(ptr);
+#else
+    std::free(ptr);
+#endif
+}
+
+void operator delete(void *ptr, std::size_t, const std::align_val_t alignment) noexcept {
+    operator delete(ptr, alignment);
+}
+
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 11
+#pragma GCC diagnostic pop
+#endif
+#endif
+
 #endif //LAYOUT_H
@@ -0,0 +1,150 @@
+#ifndef MEMORY_REPORT_H
+#define MEMORY_REPORT_H
+
+#include "ui.h"
+#include <iostream>
+#include <map>
+
+namespace UI {
+    // heap bytes of a string, 0 while it fits in the small string buffer
+    inline size_t StringHeapBytes(const std::string &str) {
+        const char *data = str.data();
+        const char *object = reinterpret_cast<const char *>(&str);
+        if (data >= object && data < object + sizeof(str))
+            return 0;
+        return str.capacity() + 1;
+    }
+
+    struct MemoryUsage {
+        size_t nodes = 0;
+        // sizeof(LayoutElement) per node, including the inline part of strings, vectors and std::functions
+        size_t elements = 0;
+        // capacity of children vectors beyond their size
+        size_t childrenSlack = 0;
+        size_t debugNames = 0;
+        // heap allocated handler functors, estimated when the handlers were set through LayoutBuilder
+        size_t captures = 0;
+        // strings owned by text components (source, wrapped text and scratch)
+        size_t text = 0;
+
+        size_t Total() const {
+            return elements + childrenSlack + debugNames + captures + text;
+        }
+
+        MemoryUsage &operator+=(const MemoryUsage &other) {
+            nodes += other.nodes;
+            elements += other.elements;
+            childrenSlack += other.childrenSlack;
+            debugNames += other.debugNames;
+            captures += other.captures;
+            text += other.text;
+            return *this;
+        }
+    };
+
+    inline MemoryUsage MeasureElement(const Layout::LayoutElement &element) {
+        MemoryUsage usage;
+        usage.nodes = 1;
+        usage.elements = sizeof(Layout::LayoutElement);
+        usage.childrenSlack = (element.children.capacity() - element.children.size()) * sizeof(Layout::LayoutElement);
+#ifndef LAYOUT_STRIP_DEBUG
+        usage.debugNames = StringHeapBytes(element.debugName);
+        usage.captures = element.captureBytes;
+#endif
+        return usage;
+    }
+
+    inline MemoryUsage MeasureSubtree(const Layout::LayoutElement &root) {
+        MemoryUsage usage;
+        std::vector<const Layout::LayoutElement *> toExplore = {&root};
+        while (!toExplore.empty()) {
+            const Layout::LayoutElement *current = toExplore.back();
+            toExplore.pop_back();
+
+            usage += MeasureElement(*current);
+
+            for (auto &child: current->children) {
+                toExplore.emplace_back(&child);
+            }
+        }
+        return usage;
+    }
+
+    inline const char *ElementType(const Layout::LayoutElement &element) {
+#ifndef LAYOUT_STRIP_DEBUG
+        return element.debugName.c_str();
+#else
+        return "Element";
+#endif
+    }
+
+    // Memory footprint of a tree, by category, by node type (debug name) and by subtree under the root,
+    // plus the text components and backend caches added to it
+    struct MemoryReport {
+        MemoryUsage total;
+        std::map<std::string, MemoryUsage> byType;
+        std::vector<std::pair<std::string, MemoryUsage> > subtrees;
+        size_t backendCaches = 0;
+
+        void AddText(const UI_Text &text) {
+            total.text += StringHeapBytes(text.text) + StringHeapBytes(text.wrapped) +
+                    StringHeapBytes(text.wrappedSource) + StringHeapBytes(text.wrapLine);
+        }
+
+        void AddText(const UI_LargeText &text) {
+            size_t bytes = text.paragraphs.capacity() * sizeof(UI_LargeText::Paragraph) +
+                           text.linePrefix.capacity() * sizeof(size_t) +
+                           StringHeapBytes(text.wrapLine) + StringHeapBytes(text.drawLine);
+            for (const auto &paragraph: text.paragraphs) {
+                bytes += StringHeapBytes(paragraph.text) + StringHeapBytes(paragraph.wrapped) +
+                        paragraph.lineStarts.capacity() * sizeof(uint32_t);
+            }
+            total.text += bytes;
+        }
+
+        size_t Total() const {
+            return total.Total() + backendCaches;
+        }
+
+        void Print(std::ostream &out = std::cout) const {
+            const auto print = [&](const std::string &name, const MemoryUsage &usage) {
+                out << name << ": " << usage.Total() << " bytes, " << usage.nodes << " nodes (elements "
+                        << usage.elements << ", children slack " << usage.childrenSlack << ", debug names "
+                        << usage.debugNames << ", captures " << usage.captures << ", text " << usage.text << ")"
+                        << std::endl;
+            };
+            print("Tree", total);
+            out << "Backend caches: " << backendCaches << " bytes" << std::endl;
+            out << "Total: " << Total() << " bytes" << std::endl;
+            out << "By type:" << std::endl;
+            for (const auto &[type, usage]: byType)
+                print("  " + type, usage);
+            out << "By subtree:" << std::endl;
+            for (const auto &[name, usage]: subtrees)
+                print("  " + name, usage);
+        }
+    };
+
+    inline MemoryReport MeasureTree(const Layout::LayoutElement &root) {
+        MemoryReport report;
+        std::vector<const Layout::LayoutElement *> toExplore = {&root};
+        while (!toExplore.empty()) {
+            const Layout::LayoutElement *current = toExplore.back();
+            toExplore.pop_back();
+
+            const MemoryUsage usage = MeasureElement(*current);
+            report.total += usage;
+            report.byType[ElementType(*current)] += usage;
+
+            for (auto &child: current->children) {
+                toExplore.emplace_back(&child);
+            }
+        }
+        for (const auto &child: root.children)
+            report.subtrees.emplace_back(ElementType(child), MeasureSubtree(child));
+        report.backendCaches = UI_CacheBytes();
+        return report;
+    }
+}
+
+#endif //MEMORY_REPORT_H
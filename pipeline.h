@@ -0,0 +1,124 @@
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include "ui.h"
+#include <atomic>
+#include <functional>
+#include <thread>
+
+namespace UI {
+    // Lock-free single-producer/single-consumer triple buffer.
+    // The writer fills Back() and publishes it, the reader picks up the latest published slot with Update().
+    // Neither side ever waits for the other, the reader just keeps its current slot until a newer one exists.
+    template<typename T>
+    class TripleBuffer {
+    public:
+        T &Back() {
+            return slots[back];
+        }
+
+        void Publish() {
+            back = middle.exchange(back | FRESH_BIT, std::memory_order_acq_rel) & INDEX_MASK;
+        }
+
+        // returns true if a newer slot was published since the last call
+        bool Update() {
+            if ((middle.load(std::memory_order_relaxed) & FRESH_BIT) == 0)
+                return false;
+            front = middle.exchange(front, std::memory_order_acq_rel) & INDEX_MASK;
+            return true;
+        }
+
+        const T &Front() const {
+            return slots[front];
+        }
+
+    private:
+        static constexpr int FRESH_BIT = 4;
+        static constexpr int INDEX_MASK = 3;
+
+        T slots[3];
+        int back = 0;
+        std::atomic<int> middle = 1;
+        int front = 2;
+    };
+
+    // Opt-in pipelined frame loop.
+    // The worker thread runs frameFn (input detection, layout and drawing of frame N+1) with draw calls recorded
+    // into a DrawList, while the render thread submits the finished list of frame N to the backend.
+    // Input is sampled on the render thread and handed over. While frameFn takes less than a render frame, the UI lags
+    // the input by at most one frame. Submit never waits for the worker, so a slower frameFn adds its overrun: the
+    // submitted list then belongs to the last input the worker picked up, which can be several render frames old.
+    // While the pipeline runs, the tree must only be touched from frameFn, and the backend measure functions must be
+    // safe to call off the render thread (the raylib and headless backends are).
+    class FramePipeline {
+    public:
+        explicit FramePipeline(std::function<void()> frameFn) : frameFn(std::move(frameFn)) {
+            worker = std::thread([this] { WorkerLoop(); });
+        }
+
+        ~FramePipeline() {
+            running.store(false, std::memory_order_release);
+            Wake();
+            worker.join();
+        }
+
+        FramePipeline(const FramePipeline &) = delete;
+
+        FramePipeline &operator=(const FramePipeline &) = delete;
+
+        // call once per frame on the render thread, between the backend's begin and end drawing
+        void Submit() {
+            if (UI_IsMousePressed())
+                pendingClicks.fetch_add(1, std::memory_order_relaxed);
+            InputState &state = inputs.Back();
+            state.mousePos = UI_GetMousePos();
+            state.mousePressed = false;
+            inputs.Publish();
+            Wake();
+
+            drawLists.Update();
+            UI_SubmitDrawList(drawLists.Front());
+        }
+
+    private:
+        // never blocks the render thread, the worker just wakes up if it was waiting
+        void Wake() {
+            published.fetch_add(1, std::memory_order_release);
+            published.notify_one();
+        }
+
+        void WorkerLoop() {
+            uint32_t seen = 0;
+            while (running.load(std::memory_order_acquire)) {
+                // sleep until Submit publishes input (or the pipeline stops)
+                published.wait(seen, std::memory_order_acquire);
+                seen = published.load(std::memory_order_acquire);
+                if (!inputs.Update())
+                    continue;
+                // a click is kept until a worker frame sees it, even if the input slot carrying it was skipped
+                InputState input = inputs.Front();
+                input.mousePressed = pendingClicks.exchange(0, std::memory_order_relaxed) > 0;
+
+                DrawList &list = drawLists.Back();
+                list.Clear();
+                inputSnapshot = &input;
+                recordingDrawList = &list;
+                frameFn();
+                recordingDrawList = nullptr;
+                inputSnapshot = nullptr;
+                drawLists.Publish();
+            }
+        }
+
+        std::function<void()> frameFn;
+        TripleBuffer<InputState> inputs;
+        TripleBuffer<DrawList> drawLists;
+        std::atomic<int> pendingClicks = 0;
+        std::atomic<uint32_t> published = 0;
+        std::atomic<bool> running = true;
+        std::thread worker;
+    };
+}
+
+#endif //PIPELINE_H
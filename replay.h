@@ -0,0 +1,248 @@
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include "ui.h"
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+
+namespace UI {
+    // Session file: the magic, then one record per frame.
+    // A record is a flags byte, the mouse position if it changed, then the tree mutations if there are any.
+    // A mutation is its kind, whether it was made after input detection (a byte), then its payload size and payload.
+    constexpr char REPLAY_MAGIC[4] = {'U', 'I', 'R', 'P'};
+
+    enum ReplayFrameFlags : uint8_t {
+        REPLAY_MOUSE_PRESSED = 1,
+        REPLAY_MOUSE_MOVED = 2,
+        REPLAY_MUTATIONS = 4,
+    };
+
+    // Application defined change of the tree, e.g. rows loaded from a file, applied again by the application on replay
+    struct TreeMutation {
+        uint32_t kind = 0;
+        std::string payload;
+        // made after DetectInputEvents in its frame, so it is replayed after input detection too
+        bool afterInput = false;
+    };
+
+    struct ReplayFrame {
+        InputState input;
+        std::vector<TreeMutation> mutations;
+    };
+
+    // Records the input of every frame, and the tree mutations reported by the application.
+    // BeginFrame samples the backend input once and serves that snapshot for the rest of the frame, so the live session
+    // sees exactly the input that is replayed. Only mutations that do not come from UI handlers should be recorded,
+    // handler mutations happen again on their own when the input is replayed.
+    // Run input detection through the recorder's DetectInputEvents, so each mutation is recorded as made before or
+    // after it, and replayed on the same side.
+    class InputRecorder {
+    public:
+        bool Open(const std::string &path) {
+            file.open(path, std::ios::binary);
+            if (!file) {
+                std::cerr << "Failed to open replay file: " << path << std::endl;
+                return false;
+            }
+            file.write(REPLAY_MAGIC, sizeof(REPLAY_MAGIC));
+            return true;
+        }
+
+        void Close() {
+            file.close();
+        }
+
+        void BeginFrame() {
+            frame.input.mousePos = UI_GetMousePos();
+            frame.input.mousePressed = UI_IsMousePressed();
+            inputSnapshot = &frame.input;
+            afterInput = false;
+        }
+
+        void DetectInputEvents(Layout::LayoutElement &root) {
+            UI::DetectInputEvents(root);
+            afterInput = true;
+        }
+
+        void RecordMutation(const uint32_t kind, const std::string_view payload) {
+            TreeMutation &mutation = frame.mutations.emplace_back();
+            mutation.kind = kind;
+            mutation.afterInput = afterInput;
+            mutation.payload.assign(payload);
+        }
+
+        void EndFrame() {
+            inputSnapshot = nullptr;
+            uint8_t flags = 0;
+            if (frame.input.mousePressed)
+                flags |= REPLAY_MOUSE_PRESSED;
+            if (frame.input.mousePos != lastMousePos)
+                flags |= REPLAY_MOUSE_MOVED;
+            if (!frame.mutations.empty())
+                flags |= REPLAY_MUTATIONS;
+
+            Write(flags);
+            if (flags & REPLAY_MOUSE_MOVED)
+                Write(frame.input.mousePos);
+            if (flags & REPLAY_MUTATIONS) {
+                Write(static_cast<uint32_t>(frame.mutations.size()));
+                for (const auto &mutation: frame.mutations) {
+                    Write(mutation.kind);
+                    Write(static_cast<uint8_t>(mutation.afterInput));
+                    Write(static_cast<uint32_t>(mutation.payload.size()));
+                    file.write(mutation.payload.data(), static_cast<std::streamsize>(mutation.payload.size()));
+                }
+            }
+            lastMousePos = frame.input.mousePos;
+            frame.mutations.clear();
+        }
+
+    private:
+        template<typename T>
+        void Write(const T &value) {
+            file.write(reinterpret_cast<const char *>(&value), sizeof(value));
+        }
+
+        std::ofstream file;
+        ReplayFrame frame;
+        bool afterInput = false;
+        std::array<float, 2> lastMousePos = {0, 0};
+    };
+
+    inline bool LoadReplay(const std::string &path, std::vector<ReplayFrame> &frames) {
+        std::ifstream file(path, std::ios::binary);
+        char magic[sizeof(REPLAY_MAGIC)];
+        if (!file.read(magic, sizeof(magic)) || !std::equal(magic, magic + sizeof(magic), REPLAY_MAGIC)) {
+            std::cerr << "Not a replay file: " << path << std::endl;
+            return false;
+        }
+
+        const auto read = [&](auto &value) {
+            return static_cast<bool>(file.read(reinterpret_cast<char *>(&value), sizeof(value)));
+        };
+        std::array<float, 2> mousePos = {0, 0};
+        uint8_t flags;
+        while (read(flags)) {
+            ReplayFrame &frame = frames.emplace_back();
+            if (flags & REPLAY_MOUSE_MOVED)
+                read(mousePos);
+            frame.input.mousePos = mousePos;
+            frame.input.mousePressed = flags & REPLAY_MOUSE_PRESSED;
+            if (flags & REPLAY_MUTATIONS) {
+                uint32_t count = 0;
+                read(count);
+                frame.mutations.resize(count);
+                for (auto &mutation: frame.mutations) {
+                    uint32_t size = 0;
+                    uint8_t afterInput = 0;
+                    read(mutation.kind);
+                    read(afterInput);
+                    read(size);
+                    mutation.afterInput = afterInput != 0;
+                    mutation.payload.resize(size);
+                    file.read(mutation.payload.data(), size);
+                }
+            }
+            if (!file) {
+                std::cerr << "Truncated replay file: " << path << std::endl;
+                frames.pop_back();
+                return false;
+            }
+        }
+        return true;
+    }
+
+    struct ReplayTiming {
+        double p50 = 0;
+        double p99 = 0;
+        double max = 0;
+        double mean = 0;
+
+        static ReplayTiming From(std::vector<double> micros) {
+            ReplayTiming timing;
+            if (micros.empty())
+                return timing;
+            std::sort(micros.begin(), micros.end());
+            timing.p50 = micros[(micros.size() - 1) / 2];
+            timing.p99 = micros[(micros.size() - 1) * 99 / 100];
+            timing.max = micros.back();
+            for (const double us: micros)
+                timing.mean += us / micros.size();
+            return timing;
+        }
+    };
+
+    // per frame timing distributions in microseconds
+    struct ReplayStats {
+        size_t frames = 0;
+        ReplayTiming input;
+        ReplayTiming layout;
+        ReplayTiming draw;
+        ReplayTiming total;
+
+        void Print(std::ostream &out = std::cout) const {
+            out << "frames: " << frames << std::endl;
+            const auto print = [&](const char *name, const ReplayTiming &timing) {
+                out << name << " p50 " << timing.p50 << "us, p99 " << timing.p99 << "us, max " << timing.max
+                        << "us, mean " << timing.mean << "us" << std::endl;
+            };
+            print("input: ", input);
+            print("layout:", layout);
+            print("draw:  ", draw);
+            print("total: ", total);
+        }
+    };
+
+    using ApplyMutationFn = std::function<void(Layout::LayoutElement &root, const TreeMutation &mutation)>;
+
+    // Feeds the recorded frames through DetectInputEvents, CalculateLayout and DrawUI, applying each recorded mutation
+    // before or after input detection as it was made. Mutations are not part of the timings.
+    // Install a headless backend first (e.g. UI_Headless_Init) so measurements are deterministic and nothing is drawn.
+    inline ReplayStats Replay(const std::vector<ReplayFrame> &frames, Layout::LayoutElement &root,
+                              const ApplyMutationFn &applyMutation) {
+        using Clock = std::chrono::steady_clock;
+        const auto micros = [](const Clock::time_point from, const Clock::time_point to) {
+            return std::chrono::duration<double, std::micro>(to - from).count();
+        };
+
+        std::vector<double> input, layout, draw, total;
+        for (const auto &frame: frames) {
+            for (const auto &mutation: frame.mutations) {
+                if (!mutation.afterInput)
+                    applyMutation(root, mutation);
+            }
+
+            inputSnapshot = &frame.input;
+            const Clock::time_point start = Clock::now();
+            DetectInputEvents(root);
+            const Clock::time_point inputDone = Clock::now();
+            for (const auto &mutation: frame.mutations) {
+                if (mutation.afterInput)
+                    applyMutation(root, mutation);
+            }
+            const Clock::time_point mutationsDone = Clock::now();
+            Layout::CalculateLayout(root);
+            const Clock::time_point layoutDone = Clock::now();
+            Layout::DrawUI(root);
+            const Clock::time_point drawDone = Clock::now();
+            inputSnapshot = nullptr;
+
+            input.emplace_back(micros(start, inputDone));
+            layout.emplace_back(micros(mutationsDone, layoutDone));
+            draw.emplace_back(micros(layoutDone, drawDone));
+            total.emplace_back(micros(start, drawDone) - micros(inputDone, mutationsDone));
+        }
+
+        ReplayStats stats;
+        stats.frames = frames.size();
+        stats.input = ReplayTiming::From(std::move(input));
+        stats.layout = ReplayTiming::From(std::move(layout));
+        stats.draw = ReplayTiming::From(std::move(draw));
+        stats.total = ReplayTiming::From(std::move(total));
+        return stats;
+    }
+}
+
+#endif //REPLAY_H
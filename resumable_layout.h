@@ -0,0 +1,171 @@
+#ifndef RESUMABLE_LAYOUT_H
+#define RESUMABLE_LAYOUT_H
+
+#include "layout.h"
+#include <chrono>
+
+namespace Layout {
+    // Lays out a newly built tree in slices under a time budget, while the application keeps drawing the last
+    // complete tree. The passes of CalculateLayout run over a flat pre-order list of the new tree, so each can stop
+    // after any node and resume in the next frame. Once the last pass finishes, Step swaps the new tree into the live
+    // one and points the reference pointers at it in one go, using the elements with a reference pointer found while
+    // collecting, instead of walking the tree again. The old tree is released in slices by the following Step calls.
+    // The new tree must not be touched by the application until the swap.
+    class ResumableLayout {
+    public:
+        enum Phase {
+            IDLE,
+            COLLECT,
+            SIZE,
+            GROW,
+            CUSTOM_SIZE,
+            GROW_AGAIN,
+            POSITION,
+        };
+
+        // called after every Step with the phase reached and the overall progress from 0 to 1
+        std::function<void(Phase phase, float progress)> onProgress = nullptr;
+
+        // Starts laying out tree. Calling it while Busy() drops the unfinished tree, nothing points into it yet.
+        void Begin(LayoutElement &&tree) {
+            if (Busy())
+                retired.emplace_back(std::move(pending));
+            pending = std::move(tree);
+            order.clear();
+            referenced.clear();
+            toExplore.clear();
+            toExplore.emplace_back(&pending);
+            cursor = 0;
+            phase = COLLECT;
+        }
+
+        bool Busy() const {
+            return phase != IDLE;
+        }
+
+        // true while the previous live tree is still being released
+        bool Retiring() const {
+            return !retired.empty();
+        }
+
+        Phase GetPhase() const {
+            return phase;
+        }
+
+        float Progress() const {
+            if (phase == IDLE)
+                return 1;
+            if (phase == COLLECT)
+                return 0;
+            return (phase - COLLECT + static_cast<float>(cursor) / order.size()) / (POSITION - COLLECT + 1);
+        }
+
+        // Continues the layout for at most about budget, returns true if it finished and live now holds the new tree.
+        // Keep calling it after that (e.g. once per frame) until Retiring() is false, to release the old tree.
+        bool Step(LayoutElement &live, const std::chrono::microseconds budget) {
+            if (phase == IDLE && retired.empty())
+                return false;
+
+            const auto deadline = std::chrono::steady_clock::now() + budget;
+            int sinceCheck = 0;
+            const auto outOfTime = [&] {
+                // checking the clock per node would cost more than most nodes
+                if (++sinceCheck < CHECK_INTERVAL)
+                    return false;
+                sinceCheck = 0;
+                return std::chrono::steady_clock::now() >= deadline;
+            };
+
+            while (!retired.empty() && !outOfTime())
+                ReleaseOne();
+
+            while (phase != IDLE && !outOfTime()) {
+                if (phase == COLLECT) {
+                    if (toExplore.empty()) {
+                        NextPhase();
+                        continue;
+                    }
+                    LayoutElement *current = toExplore.back();
+                    toExplore.pop_back();
+                    order.emplace_back(current);
+                    // the root is rebound after the swap, the other elements keep their address through it
+                    if (current != &pending && current->referencePointer != nullptr)
+                        referenced.emplace_back(current);
+                    for (auto child = current->children.rbegin(); child != current->children.rend(); ++child)
+                        toExplore.emplace_back(&*child);
+                    continue;
+                }
+
+                if (cursor == order.size()) {
+                    NextPhase();
+                    continue;
+                }
+                switch (phase) {
+                    case SIZE:
+                        // reverse pre-order visits children before their parent
+                        CalculateSize(*order[order.size() - 1 - cursor]);
+                        break;
+                    case GROW:
+                    case GROW_AGAIN:
+                        CalculateGrow(*order[cursor], context);
+                        break;
+                    case CUSTOM_SIZE:
+                        if (order[cursor]->sizeFn != nullptr)
+                            order[cursor]->sizeFn(order[cursor]);
+                        break;
+                    case POSITION:
+                        CalculateChildPositions(*order[cursor]);
+                        break;
+                    default:
+                        break;
+                }
+                cursor++;
+            }
+
+            const bool finished = phase == IDLE && !order.empty();
+            if (finished) {
+                std::swap(live, pending);
+                if (live.referencePointer != nullptr)
+                    *live.referencePointer = &live;
+                for (LayoutElement *element: referenced)
+                    *element->referencePointer = element;
+                retired.emplace_back(std::move(pending));
+                pending = LayoutElement();
+                order.clear();
+                referenced.clear();
+            }
+            if (onProgress != nullptr)
+                onProgress(phase, Progress());
+            return finished;
+        }
+
+    private:
+        static constexpr int CHECK_INTERVAL = 32;
+
+        void NextPhase() {
+            cursor = 0;
+            phase = phase == POSITION ? IDLE : static_cast<Phase>(phase + 1);
+        }
+
+        // destroys one element of the old tree, after moving its children out so they are destroyed one by one too
+        void ReleaseOne() {
+            LayoutElement element = std::move(retired.back());
+            retired.pop_back();
+            for (auto &child: element.children)
+                retired.emplace_back(std::move(child));
+        }
+
+        LayoutElement pending;
+        // elements of the old live tree waiting to be destroyed
+        std::vector<LayoutElement> retired;
+        std::vector<LayoutElement *> order;
+        // elements of the new tree below the root that have a reference pointer
+        std::vector<LayoutElement *> referenced;
+        std::vector<LayoutElement *> toExplore;
+        size_t cursor = 0;
+        Phase phase = IDLE;
+        LayoutContext context;
+    };
+}
+
+#endif //RESUMABLE_LAYOUT_H
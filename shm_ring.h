@@ -0,0 +1,253 @@
+#ifndef SHM_RING_H
+#define SHM_RING_H
+
+#include "ui.h"
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace UI {
+    struct RingHeader {
+        alignas(64) std::atomic<uint64_t> head;
+        alignas(64) std::atomic<uint64_t> tail;
+        alignas(64) uint64_t capacity;
+    };
+
+    static_assert(std::atomic<uint64_t>::is_always_lock_free, "ring counters must be usable across processes");
+
+    // Lock-free single-producer/single-consumer byte ring of length-prefixed messages, placed in caller memory
+    // (e.g. shared memory). The producer stages messages with Write and makes them visible with Commit, so a consumer
+    // sees either a whole batch (frame) or nothing. If a batch does not fit, Write fails and the producer calls
+    // Rollback instead of waiting for the consumer.
+    class SpscRing {
+    public:
+        static size_t BytesFor(const size_t capacity) {
+            return sizeof(RingHeader) + capacity;
+        }
+
+        SpscRing() = default;
+
+        // capacity must be a power of two, initialise only from the side that created the memory
+        SpscRing(void *memory, const size_t capacity, const bool initialise) {
+            header = static_cast<RingHeader *>(memory);
+            data = static_cast<uint8_t *>(memory) + sizeof(RingHeader);
+            if (initialise) {
+                new(header) RingHeader{};
+                header->capacity = capacity;
+            }
+            staged = header->head.load(std::memory_order_relaxed);
+        }
+
+        bool Write(const void *message, const uint32_t size) {
+            return Write(message, size, nullptr, 0);
+        }
+
+        // writes the two parts as a single message
+        bool Write(const void *first, const uint32_t firstSize, const void *second, const uint32_t secondSize) {
+            const uint32_t size = firstSize + secondSize;
+            const uint64_t tail = header->tail.load(std::memory_order_acquire);
+            if (staged + sizeof(size) + size - tail > header->capacity)
+                return false;
+            CopyIn(&size, sizeof(size));
+            CopyIn(first, firstSize);
+            if (second != nullptr)
+                CopyIn(second, secondSize);
+            return true;
+        }
+
+        void Commit() {
+            header->head.store(staged, std::memory_order_release);
+        }
+
+        void Rollback() {
+            staged = header->head.load(std::memory_order_relaxed);
+        }
+
+        // reads the next committed message into out, returns false if there is none
+        bool Read(std::vector<uint8_t> &out) {
+            const uint64_t tail = header->tail.load(std::memory_order_relaxed);
+            if (tail == header->head.load(std::memory_order_acquire))
+                return false;
+            uint32_t size;
+            CopyOut(tail, &size, sizeof(size));
+            out.resize(size);
+            CopyOut(tail + sizeof(size), out.data(), size);
+            header->tail.store(tail + sizeof(size) + size, std::memory_order_release);
+            return true;
+        }
+
+    private:
+        void CopyIn(const void *source, const size_t size) {
+            const size_t offset = staged & (header->capacity - 1);
+            const size_t first = std::min(size, header->capacity - offset);
+            std::memcpy(data + offset, source, first);
+            std::memcpy(data, static_cast<const uint8_t *>(source) + first, size - first);
+            staged += size;
+        }
+
+        void CopyOut(const uint64_t position, void *destination, const size_t size) const {
+            const size_t offset = position & (header->capacity - 1);
+            const size_t first = std::min(size, header->capacity - offset);
+            std::memcpy(destination, data + offset, first);
+            std::memcpy(static_cast<uint8_t *>(destination) + first, data, size - first);
+        }
+
+        RingHeader *header = nullptr;
+        uint8_t *data = nullptr;
+        // producer only, end of the messages written but not yet committed
+        uint64_t staged = 0;
+    };
+
+    // POSIX shared memory mapping, unlinked again by the process that created it
+    class SharedMemory {
+    public:
+        SharedMemory() = default;
+
+        SharedMemory(const SharedMemory &) = delete;
+
+        SharedMemory &operator=(const SharedMemory &) = delete;
+
+        ~SharedMemory() {
+            if (memory != nullptr)
+                munmap(memory, size);
+            if (owner)
+                shm_unlink(name.c_str());
+        }
+
+        bool Create(const std::string &name, const size_t size) {
+            const int fd = shm_open(name.c_str(), O_CREAT | O_RDWR, 0600);
+            if (fd < 0)
+                return false;
+            if (ftruncate(fd, static_cast<off_t>(size)) != 0) {
+                close(fd);
+                return false;
+            }
+            owner = true;
+            return Map(fd, name, size);
+        }
+
+        bool Open(const std::string &name, const size_t size) {
+            const int fd = shm_open(name.c_str(), O_RDWR, 0600);
+            if (fd < 0)
+                return false;
+            return Map(fd, name, size);
+        }
+
+        void *Data() const {
+            return memory;
+        }
+
+    private:
+        bool Map(const int fd, const std::string &name, const size_t size) {
+            void *mapped = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            close(fd);
+            if (mapped == MAP_FAILED)
+                return false;
+            this->name = name;
+            this->size = size;
+            memory = mapped;
+            return true;
+        }
+
+        std::string name;
+        size_t size = 0;
+        void *memory = nullptr;
+        bool owner = false;
+    };
+
+    // Message layout of draw commands in the ring, the string of text/image commands follows the packet
+    struct DrawPacket {
+        enum Type : uint8_t {
+            RECTANGLE = DrawCommand::RECTANGLE,
+            TEXT = DrawCommand::TEXT,
+            IMAGE = DrawCommand::IMAGE,
+            FRAME_END,
+        };
+
+        Type type = RECTANGLE;
+        uint8_t color[4] = {};
+        int32_t x = 0;
+        int32_t y = 0;
+        int32_t w = 0;
+        int32_t h = 0;
+        float scale = 1.0;
+        // steady clock time when the frame was committed, only set on FRAME_END
+        int64_t timestamp = 0;
+    };
+
+    inline int64_t ShmTimestamp() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    inline bool WriteDrawCommand(SpscRing &ring, const DrawCommand &command) {
+        DrawPacket packet;
+        packet.type = static_cast<DrawPacket::Type>(command.type);
+        for (int i = 0; i < 4; i++)
+            packet.color[i] = static_cast<uint8_t>(command.color[i]);
+        packet.x = command.x;
+        packet.y = command.y;
+        packet.w = command.w;
+        packet.h = command.h;
+        packet.scale = command.scale;
+        return ring.Write(&packet, sizeof(packet), command.str.data(), static_cast<uint32_t>(command.str.size()));
+    }
+
+    // commits the frame if its end marker fits, otherwise drops the whole frame
+    inline bool WriteFrameEnd(SpscRing &ring) {
+        DrawPacket packet;
+        packet.type = DrawPacket::FRAME_END;
+        packet.timestamp = ShmTimestamp();
+        if (!ring.Write(&packet, sizeof(packet))) {
+            ring.Rollback();
+            return false;
+        }
+        ring.Commit();
+        return true;
+    }
+
+    // Reads one committed frame into list, returns false if no whole frame is available (frames are committed whole,
+    // so a ring that runs out before the end marker is not expected). timestamp receives the time the frame was
+    // committed, it is only written when this returns true.
+    inline bool ReadFrame(SpscRing &ring, DrawList &list, std::vector<uint8_t> &scratch, int64_t &timestamp) {
+        if (!ring.Read(scratch))
+            return false;
+        list.Clear();
+        do {
+            DrawPacket packet;
+            std::memcpy(&packet, scratch.data(), sizeof(packet));
+            if (packet.type == DrawPacket::FRAME_END) {
+                timestamp = packet.timestamp;
+                return true;
+            }
+            DrawCommand &command = list.Push(static_cast<DrawCommand::Type>(packet.type));
+            for (int i = 0; i < 4; i++)
+                command.color[i] = packet.color[i];
+            command.x = packet.x;
+            command.y = packet.y;
+            command.w = packet.w;
+            command.h = packet.h;
+            command.scale = packet.scale;
+            command.str.assign(reinterpret_cast<const char *>(scratch.data()) + sizeof(packet),
+                               scratch.size() - sizeof(packet));
+        } while (ring.Read(scratch));
+        return false;
+    }
+
+    // ring sizes used by both the UI process and the renderer process
+    constexpr size_t SHM_DRAW_RING_SIZE = 1 << 22;
+    constexpr size_t SHM_INPUT_RING_SIZE = 1 << 12;
+
+    inline std::string ShmDrawRingName(const std::string &name) {
+        return name + "_draw";
+    }
+
+    inline std::string ShmInputRingName(const std::string &name) {
+        return name + "_input";
+    }
+}
+
+#endif //SHM_RING_H
@@ -0,0 +1,79 @@
+// Heap allocations and time to build deep trees through LayoutBuilder, with children passed as a braced list
+// (copied out of the initializer list at every level) and through the variadic overload (moved).
+// usage: build_bench [repetitions]
+// build: c++ -std=c++20 -O2 -I. tools/build_bench.cpp
+
+#include <chrono>
+#include <iostream>
+
+#define LAYOUT_IMPLEMENTATION
+#define LAYOUT_COUNT_ALLOCATIONS
+#include "../layout.h"
+
+using namespace Layout;
+
+LayoutBuilder Node(const int depth) {
+    // a name past the small string buffer and a capture past the std::function buffer, like real components
+    return LayoutBuilder{}.name("Node at depth " + std::to_string(depth)).size(FIT, FIT).padding(2)
+            .drawFn([depth, label = std::string(32, 'x')](LayoutElement *layout) {
+                layout->x += depth + static_cast<int>(label.size());
+            });
+}
+
+LayoutElement BinaryBraced(const int depth) {
+    if (depth == 0)
+        return Node(depth);
+    return Node(depth).children({BinaryBraced(depth - 1), BinaryBraced(depth - 1)});
+}
+
+LayoutElement BinaryVariadic(const int depth) {
+    if (depth == 0)
+        return Node(depth);
+    return Node(depth).children(BinaryVariadic(depth - 1), BinaryVariadic(depth - 1));
+}
+
+LayoutElement ChainBraced(const int depth) {
+    if (depth == 0)
+        return Node(depth);
+    return Node(depth).children({ChainBraced(depth - 1)});
+}
+
+LayoutElement ChainVariadic(const int depth) {
+    if (depth == 0)
+        return Node(depth);
+    return Node(depth).children(ChainVariadic(depth - 1));
+}
+
+void Measure(const char *name, LayoutElement (*build)(int), const int depth, const int repetitions) {
+    size_t allocations = 0;
+    size_t nodes = 0;
+    const auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < repetitions; i++) {
+        allocationCounter = &allocations;
+        LayoutElement root = build(depth);
+        allocationCounter = nullptr;
+
+        nodes = 0;
+        std::vector<const LayoutElement *> toExplore = {&root};
+        while (!toExplore.empty()) {
+            const LayoutElement *current = toExplore.back();
+            toExplore.pop_back();
+            nodes++;
+            for (auto &child: current->children)
+                toExplore.emplace_back(&child);
+        }
+    }
+    const double millis = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    std::cout << name << ": " << nodes << " nodes, " << allocations / repetitions << " allocations, "
+            << static_cast<double>(allocations) / repetitions / nodes << " per node, " << millis / repetitions
+            << "ms (including teardown)" << std::endl;
+}
+
+int main(int argc, char **argv) {
+    const int repetitions = argc > 1 ? std::atoi(argv[1]) : 5;
+    Measure("binary depth 14, braced  ", &BinaryBraced, 14, repetitions);
+    Measure("binary depth 14, variadic", &BinaryVariadic, 14, repetitions);
+    Measure("chain depth 500, braced  ", &ChainBraced, 500, repetitions);
+    Measure("chain depth 500, variadic", &ChainVariadic, 500, repetitions);
+    return 0;
+}
@@ -0,0 +1,80 @@
+// Lays out and draws N independent report trees on N threads, each through its own UI_Context and the headless
+// backend, and prints the total throughput per thread count.
+// usage: parallel_render [max threads] [rows per report] [frames per thread]
+// build: c++ -std=c++20 -O2 -I. tools/parallel_render.cpp backends/backend_headless.cpp -pthread
+
+#include <chrono>
+#include <iostream>
+#include <thread>
+
+#define LAYOUT_IMPLEMENTATION
+#include "../ui.h"
+
+using namespace UI;
+using namespace Layout;
+
+void UI_Headless_InitContext(UI_Context &context);
+
+size_t Headless_DrawCalls(UI_Context &context);
+
+struct Report {
+    LayoutElement root;
+    std::vector<UI_Text> cells;
+
+    Report(const int rows, UI_Context &context) : cells(rows * 3) {
+        root = LayoutBuilder{}.name("Report").size(800, FIT).mainAxis(VERTICAL).gap(2);
+        root.children.reserve(rows);
+        for (int row = 0; row < rows; row++) {
+            LayoutElement &element = root.children.emplace_back(
+                LayoutBuilder{}.name("Row").size(GROW, FIT).padding(4).drawFn([](LayoutElement *layout) {
+                    UI_DrawRectangle(layout->x, layout->y, layout->width, layout->height, UI_GRAY);
+                })
+            );
+            for (int column = 0; column < 3; column++) {
+                UI_Text &cell = cells[row * 3 + column];
+                cell.text = "Row " + std::to_string(row) + " column " + std::to_string(column) +
+                            " with a description long enough to wrap";
+                element.children.emplace_back(LayoutBuilder{}.name("Cell").size(GROW, FIT).pointer(&cell.layout));
+            }
+        }
+        InitReferencePointers(root, context.layout);
+        for (auto &cell: cells)
+            cell.Link();
+    }
+};
+
+int main(int argc, char **argv) {
+    const int maxThreads = argc > 1 ? std::atoi(argv[1]) : std::max(1u, std::thread::hardware_concurrency());
+    const int rows = argc > 2 ? std::atoi(argv[2]) : 500;
+    const int frames = argc > 3 ? std::atoi(argv[3]) : 200;
+
+    double singleThread = 0;
+    for (int threads = 1; threads <= maxThreads; threads++) {
+        std::vector<std::thread> workers;
+        std::vector<size_t> drawCalls(threads);
+        const auto start = std::chrono::steady_clock::now();
+        for (int t = 0; t < threads; t++) {
+            workers.emplace_back([&, t] {
+                UI_Context context;
+                UI_Headless_InitContext(context);
+                Report report(rows, context);
+                for (int frame = 0; frame < frames; frame++) {
+                    DetectInputEvents(report.root, context);
+                    CalculateLayout(report.root, context);
+                    DrawUI(report.root, context);
+                }
+                drawCalls[t] = Headless_DrawCalls(context);
+            });
+        }
+        for (auto &worker: workers)
+            worker.join();
+        const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        const double framesPerSecond = threads * frames / seconds;
+        if (threads == 1)
+            singleThread = framesPerSecond;
+        std::cout << threads << " threads: " << framesPerSecond << " frames/s, speedup "
+                << framesPerSecond / singleThread << "x, draw calls per tree " << drawCalls[0] << std::endl;
+    }
+    return 0;
+}
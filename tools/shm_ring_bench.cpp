@@ -0,0 +1,97 @@
+// Throughput and latency of the shared-memory draw ring under load.
+// A forked consumer process plays the headless renderer, the parent writes frames at the given rate, or as fast as the
+// ring accepts them when the rate is 0.
+// usage: shm_ring_bench [commands per frame] [seconds] [frames per second]
+
+#include <algorithm>
+#include <iostream>
+#include <sched.h>
+#include <sys/wait.h>
+
+#include "../shm_ring.h"
+
+int main(int argc, char **argv) {
+    const int commandsPerFrame = argc > 1 ? std::atoi(argv[1]) : 1000;
+    const int seconds = argc > 2 ? std::atoi(argv[2]) : 3;
+    const int framesPerSecond = argc > 3 ? std::atoi(argv[3]) : 0;
+    const std::string name = "/uilib_ring_bench";
+
+    UI::SharedMemory memory;
+    if (!memory.Create(name, UI::SpscRing::BytesFor(UI::SHM_DRAW_RING_SIZE))) {
+        std::cerr << "Failed to create shared memory" << std::endl;
+        return 1;
+    }
+    UI::SpscRing ring(memory.Data(), UI::SHM_DRAW_RING_SIZE, true);
+
+    // the child leaves with _exit, so it never runs the destructor of the parent's (owning) mapping
+    if (fork() == 0) {
+        UI::SharedMemory consumerMemory;
+        if (!consumerMemory.Open(name, UI::SpscRing::BytesFor(UI::SHM_DRAW_RING_SIZE))) {
+            std::cerr << "Failed to open shared memory" << std::endl;
+            _exit(1);
+        }
+        UI::SpscRing consumerRing(consumerMemory.Data(), UI::SHM_DRAW_RING_SIZE, false);
+
+        UI::DrawList frame;
+        std::vector<uint8_t> scratch;
+        std::vector<int64_t> latencies;
+        size_t commands = 0;
+        int64_t timestamp = 0;
+        int64_t start = 0;
+        int64_t last = UI::ShmTimestamp();
+        while (UI::ShmTimestamp() - last < 500'000'000) {
+            if (!UI::ReadFrame(consumerRing, frame, scratch, timestamp)) {
+                sched_yield();
+                continue;
+            }
+            last = UI::ShmTimestamp();
+            if (start == 0)
+                start = last;
+            latencies.emplace_back(last - timestamp);
+            commands += frame.count;
+        }
+        const double elapsed = (last - start) / 1e9;
+        std::sort(latencies.begin(), latencies.end());
+        const auto percentile = [&](const double p) {
+            return latencies.empty() ? 0.0 : latencies[static_cast<size_t>(p * (latencies.size() - 1))] / 1e3;
+        };
+        std::cout << "frames received:  " << latencies.size() << std::endl;
+        std::cout << "frames/s:         " << latencies.size() / elapsed << std::endl;
+        std::cout << "commands/s:       " << commands / elapsed / 1e6 << "M" << std::endl;
+        std::cout << "latency p50/p99:  " << percentile(0.5) << "us / " << percentile(0.99) << "us" << std::endl;
+        _exit(0);
+    }
+
+    UI::DrawCommand rect;
+    rect.type = UI::DrawCommand::RECTANGLE;
+    rect.w = rect.h = 10;
+    UI::DrawCommand text;
+    text.type = UI::DrawCommand::TEXT;
+    text.str = "Some label text";
+
+    size_t sent = 0;
+    size_t dropped = 0;
+    const int64_t end = UI::ShmTimestamp() + seconds * 1'000'000'000ll;
+    int64_t nextFrame = UI::ShmTimestamp();
+    while (UI::ShmTimestamp() < end) {
+        if (framesPerSecond > 0) {
+            while (UI::ShmTimestamp() < nextFrame)
+                sched_yield();
+            nextFrame += 1'000'000'000ll / framesPerSecond;
+        }
+        bool fits = true;
+        for (int i = 0; i < commandsPerFrame && fits; i++) {
+            rect.x = text.x = i;
+            fits = UI::WriteDrawCommand(ring, i % 2 == 0 ? rect : text);
+        }
+        if (fits && UI::WriteFrameEnd(ring)) {
+            sent++;
+        } else {
+            ring.Rollback();
+            dropped++;
+        }
+    }
+    wait(nullptr);
+    std::cout << "frames sent:      " << sent << ", dropped (ring full): " << dropped << std::endl;
+    return 0;
+}
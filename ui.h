@@ -6,8 +6,13 @@
 #define UI_H
 
 #include "layout.h"
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <cstdint>
+#include <memory>
 #include <string>
-#include <sstream>
+#include <string_view>
 #include <vector>
 
 namespace UI {
@@ -22,144 +27,310 @@ namespace UI {
     inline UI_Color UI_CYAN = {0, 255, 255, 255};
     inline UI_Color UI_MAGENTA = {255, 0, 255, 255};
 
+    // Snapshot of the backend input for one frame, used when layout runs off the render thread
+    struct InputState {
+        std::array<float, 2> mousePos = {0, 0};
+        bool mousePressed = false;
+    };
+
+    inline thread_local const InputState *inputSnapshot = nullptr;
+
+    // Draw calls recorded instead of issued, replayed later on the render thread
+    struct DrawCommand {
+        enum Type {
+            RECTANGLE,
+            TEXT,
+            IMAGE,
+        };
+
+        Type type = RECTANGLE;
+        int x = 0;
+        int y = 0;
+        int w = 0;
+        int h = 0;
+        float scale = 1.0;
+        std::array<int, 4> color = {0, 0, 0, 0};
+        std::string str;
+    };
+
+    struct DrawList {
+        std::vector<DrawCommand> commands;
+        size_t count = 0;
+
+        // reuses the command slots (and their string buffers) of previous frames
+        DrawCommand &Push(const DrawCommand::Type type) {
+            if (count == commands.size())
+                commands.emplace_back();
+            DrawCommand &command = commands[count++];
+            command.type = type;
+            return command;
+        }
+
+        void Clear() {
+            count = 0;
+        }
+    };
+
+    inline thread_local DrawList *recordingDrawList = nullptr;
+
     using IsMousePressedFn = bool(*)();
-    inline IsMousePressedFn isMousePressedFn = nullptr;
+    using GetMousePosFn = std::array<float, 2>(*)();
+    using DrawRectangleFn = void(*)(int, int, int, int, std::array<int, 4>);
+    using DrawImageFn = void(*)(const std::string &path, const int x, const int y, const int w, const int h);
+    using MeasureImageFn = std::array<int, 2>(*)(const std::string &path);
+    using DrawTextFn = void(*)(const char *, int, int, float);
+    using MeasureTextFn = float(*)(const char *, float);
+    using MeasureTextHeightFn = float(*)(const char *, float);
+    using CacheBytesFn = size_t(*)();
+
+    // Backend function table and per-tree state. Each thread works with its current context, so independent trees
+    // can be laid out and drawn on different threads, each through its own context.
+    struct UI_Context {
+        IsMousePressedFn isMousePressedFn = nullptr;
+        GetMousePosFn getMousePosFn = nullptr;
+        DrawRectangleFn drawRectFn = nullptr;
+        DrawImageFn drawImageFn = nullptr;
+        MeasureImageFn measureImageFn = nullptr;
+        DrawTextFn drawTextFn = nullptr;
+        MeasureTextFn measureTextFn = nullptr;
+        MeasureTextHeightFn measureTextHeightFn = nullptr;
+        CacheBytesFn cacheBytesFn = nullptr;
+
+        // scratch stacks of the layout passes and input detection, Layout::defaultLayoutContext for the default context
+        Layout::LayoutContext &layout = ownLayout;
+        // state owned by the backend for this context, e.g. caches or counters
+        std::shared_ptr<void> backendData;
+
+        UI_Context() = default;
+
+        explicit UI_Context(Layout::LayoutContext &layout) : layout(layout) {
+        }
+
+        UI_Context(const UI_Context &) = delete;
+
+        UI_Context &operator=(const UI_Context &) = delete;
+
+    private:
+        Layout::LayoutContext ownLayout;
+    };
+
+    inline UI_Context defaultContext(Layout::defaultLayoutContext);
+    inline thread_local UI_Context *currentContext = &defaultContext;
+
+    // the backend hooks of the default context, set by the backends' init functions
+    inline IsMousePressedFn &isMousePressedFn = defaultContext.isMousePressedFn;
+    inline GetMousePosFn &getMousePosFn = defaultContext.getMousePosFn;
+    inline DrawRectangleFn &drawRectFn = defaultContext.drawRectFn;
+    inline DrawImageFn &drawImageFn = defaultContext.drawImageFn;
+    inline MeasureImageFn &measureImageFn = defaultContext.measureImageFn;
+    inline DrawTextFn &drawTextFn = defaultContext.drawTextFn;
+    inline MeasureTextFn &measureTextFn = defaultContext.measureTextFn;
+    inline MeasureTextHeightFn &measureTextHeightFn = defaultContext.measureTextHeightFn;
+    inline CacheBytesFn &cacheBytesFn = defaultContext.cacheBytesFn;
+
+    inline UI_Context &UI_CurrentContext() {
+        return *currentContext;
+    }
+
+    // Makes a context current on this thread until the end of the scope
+    struct ContextScope {
+        UI_Context *previous;
+        Layout::LayoutContext *previousLayout;
+
+        explicit ContextScope(UI_Context &context) : previous(currentContext),
+                                                     previousLayout(Layout::currentLayoutContext) {
+            currentContext = &context;
+            Layout::currentLayoutContext = &context.layout;
+        }
+
+        ~ContextScope() {
+            currentContext = previous;
+            Layout::currentLayoutContext = previousLayout;
+        }
+    };
 
     inline bool UI_IsMousePressed() {
-        if (isMousePressedFn != nullptr) {
-            return isMousePressedFn();
+        if (inputSnapshot != nullptr) {
+            return inputSnapshot->mousePressed;
+        }
+        if (currentContext->isMousePressedFn != nullptr) {
+            return currentContext->isMousePressedFn();
         }
         return false;
     }
 
-    using GetMousePosFn = std::array<float, 2>(*)();
-    inline GetMousePosFn getMousePosFn = nullptr;
-
     inline std::array<float, 2> UI_GetMousePos() {
-        if (getMousePosFn != nullptr) {
-            return getMousePosFn();
+        if (inputSnapshot != nullptr) {
+            return inputSnapshot->mousePos;
+        }
+        if (currentContext->getMousePosFn != nullptr) {
+            return currentContext->getMousePosFn();
         }
         return {0, 0};
     }
 
-    using DrawRectangleFn = void(*)(int, int, int, int, std::array<int, 4>);
-    inline DrawRectangleFn drawRectFn = nullptr;
-
     inline void UI_DrawRectangle(const int x, const int y, const int w, const int h, const std::array<int, 4> color) {
-        if (drawRectFn != nullptr) {
-            drawRectFn(x, y, w, h, color);
+        if (recordingDrawList != nullptr) {
+            DrawCommand &command = recordingDrawList->Push(DrawCommand::RECTANGLE);
+            command.x = x;
+            command.y = y;
+            command.w = w;
+            command.h = h;
+            command.color = color;
+            return;
+        }
+        if (currentContext->drawRectFn != nullptr) {
+            currentContext->drawRectFn(x, y, w, h, color);
         }
     }
 
-    using DrawImageFn = void(*)(const std::string &path, const int x, const int y, const int w, const int h);
-    inline DrawImageFn drawImageFn = nullptr;
-
     inline void UI_DrawImage(const std::string &path, const int x, const int y, const int w, const int h) {
-        if (drawImageFn != nullptr) {
-            drawImageFn(path, x, y, w, h);
+        if (recordingDrawList != nullptr) {
+            DrawCommand &command = recordingDrawList->Push(DrawCommand::IMAGE);
+            command.x = x;
+            command.y = y;
+            command.w = w;
+            command.h = h;
+            command.str.assign(path);
+            return;
+        }
+        if (currentContext->drawImageFn != nullptr) {
+            currentContext->drawImageFn(path, x, y, w, h);
         }
     }
 
-    using MeasureImageFn = std::array<int, 2>(*)(const std::string &path);
-    inline MeasureImageFn measureImageFn = nullptr;
-
     inline std::array<int, 2> UI_MeasureImage(const std::string &path) {
-        if (measureImageFn != nullptr) {
-            return measureImageFn(path);
+        if (currentContext->measureImageFn != nullptr) {
+            return currentContext->measureImageFn(path);
         }
         return {0, 0};
     }
 
-    using DrawTextFn = void(*)(const char *, int, int, float);
-    inline DrawTextFn drawTextFn = nullptr;
-
     inline void UI_DrawText(const char *str, const int x, const int y, const float scale) {
-        if (drawTextFn != nullptr) {
-            drawTextFn(str, x, y, scale);
+        if (recordingDrawList != nullptr) {
+            DrawCommand &command = recordingDrawList->Push(DrawCommand::TEXT);
+            command.x = x;
+            command.y = y;
+            command.scale = scale;
+            command.str.assign(str);
+            return;
+        }
+        if (currentContext->drawTextFn != nullptr) {
+            currentContext->drawTextFn(str, x, y, scale);
         }
     }
 
-    using MeasureTextFn = float(*)(const char *, float);
-    inline MeasureTextFn measureTextFn = nullptr;
-
     inline float UI_MeasureText(const char *str, const float scale) {
-        if (measureTextFn != nullptr) {
-            return measureTextFn(str, scale);
+        if (currentContext->measureTextFn != nullptr) {
+            return currentContext->measureTextFn(str, scale);
         }
         return 0;
     }
 
-    using MeasureTextHeightFn = float(*)(const char *, float);
-    inline MeasureTextHeightFn measureTextHeightFn = nullptr;
-
     inline float UI_MeasureTextHeight(const char *str, const float scale) {
-        if (measureTextHeightFn != nullptr) {
-            return measureTextHeightFn(str, scale);
+        if (currentContext->measureTextHeightFn != nullptr) {
+            return currentContext->measureTextHeightFn(str, scale);
         }
         return 0;
     }
 
-    inline std::string UI_WrapText(const std::string &text, float scale, float maxWidth) {
-        std::vector<std::string> paragraphs;
+    // Issues the recorded commands to the backend, must be called with recording disabled
+    inline void UI_SubmitDrawList(const DrawList &list) {
+        for (size_t i = 0; i < list.count; i++) {
+            const DrawCommand &command = list.commands[i];
+            switch (command.type) {
+                case DrawCommand::RECTANGLE:
+                    UI_DrawRectangle(command.x, command.y, command.w, command.h, command.color);
+                    break;
+                case DrawCommand::TEXT:
+                    UI_DrawText(command.str.c_str(), command.x, command.y, command.scale);
+                    break;
+                case DrawCommand::IMAGE:
+                    UI_DrawImage(command.str, command.x, command.y, command.w, command.h);
+                    break;
+            }
+        }
+    }
+
+    // bytes held by the backend's caches, e.g. loaded textures
+    inline size_t UI_CacheBytes() {
+        if (currentContext->cacheBytesFn != nullptr) {
+            return currentContext->cacheBytesFn();
+        }
+        return 0;
+    }
+
+    // Wraps text into output, reusing the capacity of output and line, so re-wrapping does not allocate once the
+    // buffers are large enough
+    inline void UI_WrapText(const std::string_view text, const float scale, const float maxWidth, std::string &output,
+                            std::string &line) {
+        output.clear();
         size_t start = 0;
         // split on existing newlines
         while (true) {
-            size_t pos = text.find('\n', start);
-            if (pos == std::string::npos) {
-                paragraphs.emplace_back(text.substr(start));
-                break;
-            }
-            paragraphs.emplace_back(text.substr(start, pos - start));
-            start = pos + 1;
-        }
+            size_t end = text.find('\n', start);
+            if (end == std::string_view::npos)
+                end = text.size();
+            const std::string_view para = text.substr(start, end - start);
+
+            line.clear();
+            size_t i = 0;
+            while (true) {
+                while (i < para.size() && std::isspace(static_cast<unsigned char>(para[i])))
+                    i++;
+                if (i >= para.size())
+                    break;
+                const size_t wordStart = i;
+                while (i < para.size() && !std::isspace(static_cast<unsigned char>(para[i])))
+                    i++;
+                const std::string_view word = para.substr(wordStart, i - wordStart);
 
-        std::string output;
-        for (size_t pi = 0; pi < paragraphs.size(); ++pi) {
-            const std::string &para = paragraphs[pi];
-            std::istringstream iss(para);
-            std::string word;
-            std::string line;
-            while (iss >> word) {
                 if (line.empty()) {
                     // first word on line
-                    line = word;
+                    line.assign(word);
                 } else {
                     // test adding word with a space
-                    std::string test = line + ' ' + word;
-                    if (UI_MeasureText(test.c_str(), scale) <= maxWidth) {
-                        line = std::move(test);
-                    } else {
+                    const size_t lineLength = line.size();
+                    line += ' ';
+                    line += word;
+                    if (UI_MeasureText(line.c_str(), scale) > maxWidth) {
                         // flush current line
+                        line.resize(lineLength);
                         output += line;
                         output += '\n';
-                        line = word;
+                        line.assign(word);
                     }
                 }
                 // handle a single word longer than maxWidth
                 if (UI_MeasureText(line.c_str(), scale) > maxWidth) {
-                    // break mid-word
-                    std::string part;
+                    // break mid-word, the part being built is the tail of output
+                    size_t partStart = output.size();
                     for (char c: line) {
-                        part.push_back(c);
-                        if (UI_MeasureText(part.c_str(), scale) > maxWidth) {
+                        output.push_back(c);
+                        if (UI_MeasureText(output.c_str() + partStart, scale) > maxWidth) {
                             // emit everything up to previous char
-                            part.pop_back();
-                            output += part;
-                            output += '\n';
-                            part.clear();
-                            part.push_back(c);
+                            output.back() = '\n';
+                            partStart = output.size();
+                            output.push_back(c);
                         }
                     }
-                    line = std::move(part);
+                    line.assign(output, partStart);
+                    output.resize(partStart);
                 }
             }
             // flush last line of paragraph
-            if (!line.empty()) {
-                output += line;
-            }
-            if (pi + 1 < paragraphs.size())
-                output += '\n'; // preserve original blank‐line separators
+            output += line;
+            if (end == text.size())
+                break;
+            output += '\n'; // preserve original blank-line separators
+            start = end + 1;
         }
+    }
+
+    inline std::string UI_WrapText(const std::string &text, float scale, float maxWidth) {
+        std::string output;
+        std::string line;
+        UI_WrapText(text, scale, maxWidth, output, line);
         return output;
     }
 
@@ -169,9 +340,13 @@ namespace UI {
                mouse[1] >= element.y && mouse[1] <= element.y + element.height;
     }
 
-    inline void DetectInputEvents(Layout::LayoutElement &root) {
-        std::vector<Layout::LayoutElement *> toExplore = {&root};
-        while (!toExplore.empty()) {
+    inline void DetectInputEvents(Layout::LayoutElement &root,
+                                  Layout::LayoutContext &context = *Layout::currentLayoutContext) {
+        Layout::AllocationPhase phase(context, Layout::PHASE_INPUT);
+        std::vector<Layout::LayoutElement *> &toExplore = context.toExplore;
+        const size_t base = toExplore.size();
+        toExplore.emplace_back(&root);
+        while (toExplore.size() > base) {
             Layout::LayoutElement *current = toExplore.back();
             toExplore.pop_back();
 
@@ -201,6 +376,22 @@ namespace UI {
         }
     }
 
+    // Runs the frame functions on root with context current on this thread, using its backend and scratch state
+    inline void DetectInputEvents(Layout::LayoutElement &root, UI_Context &context) {
+        ContextScope scope(context);
+        DetectInputEvents(root, context.layout);
+    }
+
+    inline void CalculateLayout(Layout::LayoutElement &root, UI_Context &context) {
+        ContextScope scope(context);
+        Layout::CalculateLayout(root, context.layout);
+    }
+
+    inline void DrawUI(Layout::LayoutElement &root, UI_Context &context) {
+        ContextScope scope(context);
+        Layout::DrawUI(root, context.layout);
+    }
+
     enum TextWrap {
         WRAP_NONE = 0,
         WRAP_WORD = 1,
@@ -212,10 +403,26 @@ namespace UI {
         float scale = 1.0;
         TextWrap wrap = WRAP_WORD;
 
+        // wrapped text of the last frame, only re-wrapped when text, scale or width change
+        std::string wrapped;
+        std::string wrappedSource;
+        float wrappedScale = 0;
+        int wrappedWidth = -1;
+        std::string wrapLine;
+
+        const std::string &Wrapped(const int width) {
+            if (width != wrappedWidth || scale != wrappedScale || text != wrappedSource) {
+                UI_WrapText(text, scale, width, wrapped, wrapLine);
+                wrappedSource.assign(text);
+                wrappedScale = scale;
+                wrappedWidth = width;
+            }
+            return wrapped;
+        }
+
         void SizeFn(Layout::LayoutElement *layout) {
             if (wrap == WRAP_WORD) {
-                layout->height = UI_MeasureTextHeight(UI_WrapText(text, scale, layout->width).c_str(),
-                                                      scale);
+                layout->height = UI_MeasureTextHeight(Wrapped(layout->width).c_str(), scale);
             } else {
                 layout->width = UI_MeasureText(text.c_str(), scale);
                 layout->height = UI_MeasureTextHeight(text.c_str(), scale);
@@ -224,8 +431,7 @@ namespace UI {
 
         void DrawFn(Layout::LayoutElement *layout) {
             if (wrap == WRAP_WORD) {
-                UI_DrawText(
-                    UI_WrapText(text, scale, layout->width).c_str(), layout->x, layout->y, scale);
+                UI_DrawText(Wrapped(layout->width).c_str(), layout->x, layout->y, scale);
             } else {
                 UI_DrawText(text.c_str(), layout->x, layout->y, scale);
             }
@@ -242,6 +448,169 @@ namespace UI {
         }
     };
 
+    // Text view for very large, mostly appended content such as logs and consoles.
+    // Text is kept per paragraph and only appended or edited paragraphs are re-wrapped. A prefix sum of the line
+    // counts maps the visible range to paragraphs, so only the lines inside the element are drawn.
+    // The element does not grow with the content, scrollY scrolls it and ContentHeight() gives the full height.
+    struct UI_LargeText {
+        struct Paragraph {
+            std::string text;
+            std::string wrapped;
+            // offsets of the lines in wrapped (or text when not wrapping)
+            std::vector<uint32_t> lineStarts;
+            bool dirty = true;
+        };
+
+        Layout::LayoutElement *layout;
+        float scale = 1.0;
+        TextWrap wrap = WRAP_WORD;
+        int scrollY = 0;
+
+        std::vector<Paragraph> paragraphs;
+        // linePrefix[i] is the number of lines before paragraph i, up to date before firstDirty
+        std::vector<size_t> linePrefix = {0};
+        size_t firstDirty = 0;
+        int wrappedWidth = -1;
+        float wrappedScale = 0;
+        TextWrap wrappedMode = WRAP_WORD;
+        // the last paragraph was appended without a newline, the next Append continues it
+        bool lastOpen = false;
+        std::string wrapLine;
+        std::string drawLine;
+
+        // Appends text as if to one string: every line becomes a paragraph, text after the last newline stays open
+        // and the next Append continues it, and a trailing newline only ends the current line
+        void Append(const std::string_view text) {
+            size_t start = 0;
+            if (lastOpen && !paragraphs.empty()) {
+                const size_t index = paragraphs.size() - 1;
+                const size_t end = text.find('\n');
+                paragraphs[index].text.append(text.substr(0, end));
+                paragraphs[index].dirty = true;
+                firstDirty = std::min(firstDirty, index);
+                if (end == std::string_view::npos)
+                    return;
+                start = end + 1;
+            }
+            firstDirty = std::min(firstDirty, paragraphs.size());
+            lastOpen = false;
+            while (start < text.size()) {
+                const size_t end = text.find('\n', start);
+                paragraphs.emplace_back().text.assign(text.substr(start, end - start));
+                if (end == std::string_view::npos) {
+                    lastOpen = true;
+                    break;
+                }
+                start = end + 1;
+            }
+        }
+
+        void SetParagraph(const size_t index, const std::string_view text) {
+            paragraphs[index].text.assign(text);
+            paragraphs[index].dirty = true;
+            firstDirty = std::min(firstDirty, index);
+        }
+
+        void Clear() {
+            paragraphs.clear();
+            lastOpen = false;
+            linePrefix.resize(1);
+            firstDirty = 0;
+        }
+
+        float LineHeight() const {
+            return UI_MeasureTextHeight("Ag", scale);
+        }
+
+        size_t LineCount() const {
+            return linePrefix.back();
+        }
+
+        int ContentHeight() const {
+            return static_cast<int>(LineCount() * LineHeight());
+        }
+
+        // re-wraps dirty paragraphs and fixes the prefix sum after them
+        void Update(const int width) {
+            if (width != wrappedWidth || scale != wrappedScale || wrap != wrappedMode) {
+                for (auto &paragraph: paragraphs)
+                    paragraph.dirty = true;
+                firstDirty = 0;
+                wrappedWidth = width;
+                wrappedScale = scale;
+                wrappedMode = wrap;
+            }
+            if (firstDirty >= paragraphs.size())
+                return;
+
+            linePrefix.resize(paragraphs.size() + 1);
+            for (size_t i = firstDirty; i < paragraphs.size(); i++) {
+                Paragraph &paragraph = paragraphs[i];
+                if (paragraph.dirty)
+                    Wrap(paragraph, width);
+                linePrefix[i + 1] = linePrefix[i] + paragraph.lineStarts.size();
+            }
+            firstDirty = paragraphs.size();
+        }
+
+        void SizeFn(Layout::LayoutElement *layout) {
+            Update(layout->width);
+        }
+
+        void DrawFn(Layout::LayoutElement *layout) {
+            Update(layout->width);
+            const float lineHeight = LineHeight();
+            if (lineHeight <= 0 || LineCount() == 0)
+                return;
+
+            const size_t first = static_cast<size_t>(std::max(0.0f, scrollY / lineHeight));
+            const size_t last = std::min(LineCount(),
+                                         static_cast<size_t>(std::max(0.0f, (scrollY + layout->height) / lineHeight)) + 1);
+            if (first >= last)
+                return;
+
+            size_t p = std::upper_bound(linePrefix.begin(), linePrefix.end(), first) - linePrefix.begin() - 1;
+            for (size_t line = first; line < last; line++) {
+                while (line >= linePrefix[p + 1])
+                    p++;
+                const Paragraph &paragraph = paragraphs[p];
+                const std::string &lines = wrap == WRAP_WORD ? paragraph.wrapped : paragraph.text;
+                const size_t k = line - linePrefix[p];
+                const size_t start = paragraph.lineStarts[k];
+                const size_t end = k + 1 < paragraph.lineStarts.size() ? paragraph.lineStarts[k + 1] - 1 : lines.size();
+                drawLine.assign(lines, start, end - start);
+                const int y = layout->y + static_cast<int>(line * lineHeight) - scrollY;
+                UI_DrawText(drawLine.c_str(), layout->x, y, scale);
+            }
+        }
+
+        void Link() {
+            if (layout == nullptr) return;
+            layout->sizeFn = [&](Layout::LayoutElement *layout) {
+                SizeFn(layout);
+            };
+            layout->drawFn = [&](Layout::LayoutElement *layout) {
+                DrawFn(layout);
+            };
+        }
+
+    private:
+        void Wrap(Paragraph &paragraph, const int width) {
+            const std::string *lines = &paragraph.text;
+            if (wrap == WRAP_WORD) {
+                UI_WrapText(paragraph.text, scale, width, paragraph.wrapped, wrapLine);
+                lines = &paragraph.wrapped;
+            }
+            paragraph.lineStarts.clear();
+            paragraph.lineStarts.emplace_back(0);
+            for (size_t i = 0; i < lines->size(); i++) {
+                if ((*lines)[i] == '\n')
+                    paragraph.lineStarts.emplace_back(static_cast<uint32_t>(i + 1));
+            }
+            paragraph.dirty = false;
+        }
+    };
+
     struct UI_Image {
         Layout::LayoutElement *layout;
         std::string path;